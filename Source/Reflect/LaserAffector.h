@@ -25,14 +25,14 @@ public:
 	 * Called when a Laser starts overlapping with this object.
 	 * @param Laser			The laser object that started overlapping this object.
 	 */
-	UFUNCTION(BlueprintImplementableEvent)
+	UFUNCTION(BlueprintNativeEvent)
 	void LaserBeginOverlap(ALaserBase* Laser);
 
 	/**
 	* Called when a Laser ends overlapping with this object.
 	* @param Laser			The laser object that ended overlapping this object.
 	*/
-	UFUNCTION(BlueprintImplementableEvent)
+	UFUNCTION(BlueprintNativeEvent)
 	void LaserEndOverlap(ALaserBase* Laser);
 
 	/**
@@ -40,6 +40,6 @@ public:
 	 * @param Laser			The laser object that is overlapping this object.
 	 * @param DeltaSeconds	Amount of time since last tick.
 	 */
-	UFUNCTION(BlueprintImplementableEvent)
+	UFUNCTION(BlueprintNativeEvent)
 	void LaserTick(ALaserBase* Laser, float DeltaSeconds);
 };
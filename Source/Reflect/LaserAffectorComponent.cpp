@@ -0,0 +1,40 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Reflect.h"
+#include "LaserAffectorComponent.h"
+#include "LaserBase.h"
+
+
+ULaserAffectorComponent::ULaserAffectorComponent(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer)
+{
+	// Lasers should pass through the volume, instead of bouncing off it
+	SetCollisionProfileName(TEXT("Trigger"));
+	SetCollisionResponseToChannel(ECC_Laser, ECR_Overlap);
+	bGenerateOverlapEvents = true;
+
+	bHasBlueprintLaserTick = false;
+}
+
+void ULaserAffectorComponent::OnRegister()
+{
+	Super::OnRegister();
+
+	bHasBlueprintLaserTick = GetClass()->IsFunctionImplementedInBlueprint(GET_FUNCTION_NAME_CHECKED(ULaserAffectorComponent, LaserTick));
+}
+
+void ULaserAffectorComponent::ApplyToLaser(ALaserBase* Laser, float DeltaSeconds)
+{
+}
+
+void ULaserAffectorComponent::LaserBeginOverlap_Implementation(ALaserBase* Laser)
+{
+}
+
+void ULaserAffectorComponent::LaserEndOverlap_Implementation(ALaserBase* Laser)
+{
+}
+
+void ULaserAffectorComponent::LaserTick_Implementation(ALaserBase* Laser, float DeltaSeconds)
+{
+	ApplyToLaser(Laser, DeltaSeconds);
+}
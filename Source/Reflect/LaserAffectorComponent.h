@@ -0,0 +1,60 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "Components/BoxComponent.h"
+#include "LaserAffector.h"
+#include "LaserAffectorComponent.generated.h"
+
+/**
+ * Base class for volumes that affect the lasers inside them from C++.
+ * The laser simulation calls ApplyToLaser directly, so these affectors never go
+ * through the Blueprint VM unless a Blueprint subclass overrides LaserTick.
+ */
+UCLASS(Abstract, ClassGroup = (Laser))
+class REFLECT_API ULaserAffectorComponent : public UBoxComponent, public ILaserAffector
+{
+	GENERATED_UCLASS_BODY()
+
+	// Called when the component is created or loaded.
+	virtual void OnRegister() override;
+
+	/**
+	 * Affects a laser inside the volume. Called on every simulation step.
+	 * @param Laser				The laser inside the volume.
+	 * @param DeltaSeconds		Duration of the simulation step.
+	 */
+	virtual void ApplyToLaser(ALaserBase* Laser, float DeltaSeconds);
+
+	/**
+	 * Lets the affector act on a laser, through the Blueprint override of LaserTick if there is one.
+	 * @param Laser				The laser inside the volume.
+	 * @param DeltaSeconds		Duration of the simulation step.
+	 */
+	FORCEINLINE void DispatchLaserTick(ALaserBase* Laser, float DeltaSeconds)
+	{
+		if (bHasBlueprintLaserTick)
+		{
+			ILaserAffector::Execute_LaserTick(this, Laser, DeltaSeconds);
+		}
+		else
+		{
+			ApplyToLaser(Laser, DeltaSeconds);
+		}
+	}
+
+	/***************************************/
+	/* ILaserAffector                      */
+	/***************************************/
+
+	virtual void LaserBeginOverlap_Implementation(ALaserBase* Laser) override;
+
+	virtual void LaserEndOverlap_Implementation(ALaserBase* Laser) override;
+
+	virtual void LaserTick_Implementation(ALaserBase* Laser, float DeltaSeconds) override;
+
+private:
+
+	// Whether a Blueprint subclass overrides LaserTick.
+	bool bHasBlueprintLaserTick;
+};
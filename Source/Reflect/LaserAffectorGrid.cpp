@@ -0,0 +1,215 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Reflect.h"
+#include "LaserAffectorGrid.h"
+#include "LaserAffectorComponent.h"
+#include "LaserSimulationManager.h"
+
+namespace
+{
+	// Checks whether a volume overlaps a sphere, without going through the physics scene for boxes.
+	bool OverlapsSphere(UPrimitiveComponent* Component, const FVector& Position, float Radius)
+	{
+		if (const UBoxComponent* Box = Cast<UBoxComponent>(Component))
+		{
+			// Closest point on the oriented box to the sphere
+			const FTransform& Transform = Box->GetComponentTransform();
+			const FVector Extent = Box->GetUnscaledBoxExtent();
+			const FVector LocalClosest = Transform.InverseTransformPosition(Position).BoundToBox(-Extent, Extent);
+			return FVector::DistSquared(Transform.TransformPosition(LocalClosest), Position) <= FMath::Square(Radius);
+		}
+
+		return Component->OverlapComponent(Position, FQuat::Identity, FCollisionShape::MakeSphere(Radius));
+	}
+}
+
+FLaserAffectorGrid::FLaserAffectorGrid()
+	: CellSize(500.0f)
+	, bHasMovableAffectors(false)
+{
+}
+
+void FLaserAffectorGrid::Build(UWorld* World, float InCellSize)
+{
+	Reset();
+	CellSize = FMath::Max(InCellSize, 1.0f);
+
+	for (TActorIterator<AActor> It(World); It; ++It)
+	{
+		AddActor(*It);
+	}
+}
+
+void FLaserAffectorGrid::AddActor(AActor* Actor)
+{
+	const bool bIsAffectorActor = ALaserSimulationManager::IsLaserAffector(Actor);
+
+	TInlineComponentArray<UPrimitiveComponent*> Components(Actor);
+	for (UPrimitiveComponent* Component : Components)
+	{
+		// Same volumes that would report overlaps to ALaserBase::OnBeginOverlap
+		if (Component->IsA<ULaserAffectorComponent>() || (bIsAffectorActor && Component->bGenerateOverlapEvents && Component->IsCollisionEnabled()))
+		{
+			AddComponent(Component);
+		}
+	}
+}
+
+void FLaserAffectorGrid::Reset()
+{
+	Entries.Reset();
+	Cells.Reset();
+	IndexedComponents.Reset();
+	bHasMovableAffectors = false;
+}
+
+void FLaserAffectorGrid::AddComponent(UPrimitiveComponent* Component)
+{
+	// Movable volumes would have to be moved in the grid, so they keep using overlap events.
+	// Stationary volumes can not move during play, so they are indexed like static ones.
+	if (Component->Mobility == EComponentMobility::Movable)
+	{
+		bHasMovableAffectors = true;
+		return;
+	}
+
+	const int32 Index = Entries.AddDefaulted();
+	FEntry& Entry = Entries[Index];
+	Entry.Component = Component;
+	Entry.Bounds = Component->Bounds.GetBox();
+	IndexedComponents.Add(Component);
+
+	const FIntVector MinCell = GetCell(Entry.Bounds.Min);
+	const FIntVector MaxCell = GetCell(Entry.Bounds.Max);
+	for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+		{
+			for (int32 Z = MinCell.Z; Z <= MaxCell.Z; Z++)
+			{
+				Cells.FindOrAdd(FIntVector(X, Y, Z)).Add(Index);
+			}
+		}
+	}
+}
+
+void FLaserAffectorGrid::Query(const FVector& Position, float Radius, TArray<int32>& OutEntries) const
+{
+	OutEntries.Reset();
+
+	const FVector RadiusVector(Radius);
+	const FIntVector MinCell = GetCell(Position - RadiusVector);
+	const FIntVector MaxCell = GetCell(Position + RadiusVector);
+	const bool bSingleCell = MinCell == MaxCell;
+
+	for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+		{
+			for (int32 Z = MinCell.Z; Z <= MaxCell.Z; Z++)
+			{
+				const TArray<int32>* CellEntries = Cells.Find(FIntVector(X, Y, Z));
+				if (!CellEntries)
+				{
+					continue;
+				}
+
+				for (int32 Index : *CellEntries)
+				{
+					const FEntry& Entry = Entries[Index];
+					UPrimitiveComponent* Component = Entry.Component.Get();
+
+					if (Component && Entry.Bounds.ComputeSquaredDistanceToPoint(Position) <= FMath::Square(Radius)
+						&& (bSingleCell || !OutEntries.Contains(Index))
+						&& OverlapsSphere(Component, Position, Radius))
+					{
+						OutEntries.Add(Index);
+					}
+				}
+			}
+		}
+	}
+
+	OutEntries.Sort();
+}
+
+float FLaserAffectorGrid::FindFirstEntry(const FVector& Start, const FVector& End, float Radius) const
+{
+	float FirstTime = 1.0f;
+	const FVector RadiusVector(Radius);
+	const FIntVector MinCell = GetCell(Start.ComponentMin(End) - RadiusVector);
+	const FIntVector MaxCell = GetCell(Start.ComponentMax(End) + RadiusVector);
+
+	// The bounds of the volumes are tested instead of their shapes, which can only find an earlier entry
+	auto TestCell = [&](const TArray<int32>& CellEntries)
+	{
+		FVector HitLocation;
+		FVector HitNormal;
+		float HitTime;
+		for (int32 Index : CellEntries)
+		{
+			const FEntry& Entry = Entries[Index];
+			if (Entry.Component.IsValid() && FMath::LineExtentBoxIntersection(Entry.Bounds, Start, End, RadiusVector, HitLocation, HitNormal, HitTime))
+			{
+				FirstTime = FMath::Min(FirstTime, HitTime);
+			}
+		}
+	};
+
+	// Long segments can cover more cells than there are cells with volumes in them
+	const int64 NumCells = int64(MaxCell.X - MinCell.X + 1) * (MaxCell.Y - MinCell.Y + 1) * (MaxCell.Z - MinCell.Z + 1);
+	if (NumCells > Cells.Num())
+	{
+		for (const TPair<FIntVector, TArray<int32>>& Cell : Cells)
+		{
+			const FIntVector& Key = Cell.Key;
+			if (Key.X >= MinCell.X && Key.X <= MaxCell.X && Key.Y >= MinCell.Y && Key.Y <= MaxCell.Y && Key.Z >= MinCell.Z && Key.Z <= MaxCell.Z)
+			{
+				TestCell(Cell.Value);
+			}
+		}
+	}
+	else
+	{
+		for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+		{
+			for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+			{
+				for (int32 Z = MinCell.Z; Z <= MaxCell.Z; Z++)
+				{
+					if (const TArray<int32>* CellEntries = Cells.Find(FIntVector(X, Y, Z)))
+					{
+						TestCell(*CellEntries);
+					}
+				}
+			}
+		}
+	}
+
+	return FirstTime;
+}
+
+const FLaserAffectorGrid::FEntry& FLaserAffectorGrid::GetEntry(int32 Index) const
+{
+	return Entries[Index];
+}
+
+bool FLaserAffectorGrid::Contains(const UPrimitiveComponent* Component) const
+{
+	return IndexedComponents.Contains(Component);
+}
+
+bool FLaserAffectorGrid::HasMovableAffectors() const
+{
+	return bHasMovableAffectors;
+}
+
+int32 FLaserAffectorGrid::Num() const
+{
+	return Entries.Num();
+}
+
+FIntVector FLaserAffectorGrid::GetCell(const FVector& Position) const
+{
+	return FIntVector(FMath::FloorToInt(Position.X / CellSize), FMath::FloorToInt(Position.Y / CellSize), FMath::FloorToInt(Position.Z / CellSize));
+}
@@ -0,0 +1,93 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+/**
+ * Uniform grid over the static laser affector volumes of a world.
+ * Lets the laser simulation find the affectors at a position without physics overlap events.
+ * Volumes with Static or Stationary mobility are indexed. Movable volumes are not, even if they never move,
+ * and keep reaching lasers through overlap events. Set affectors that do not move to Static to have them indexed.
+ */
+class REFLECT_API FLaserAffectorGrid
+{
+public:
+
+	struct FEntry
+	{
+		// The affector volume.
+		TWeakObjectPtr<UPrimitiveComponent> Component;
+
+		// World space bounds of the volume.
+		FBox Bounds;
+	};
+
+	FLaserAffectorGrid();
+
+	/**
+	 * Indexes the static and stationary affector volumes of a world, replacing what was indexed before.
+	 * @param World				The world to index.
+	 * @param InCellSize		The size of the grid cells.
+	 */
+	void Build(UWorld* World, float InCellSize);
+
+	// Removes every indexed volume.
+	void Reset();
+
+	/**
+	 * Indexes the affector volumes of an actor, or notes that they can move.
+	 * @param Actor				The actor, like one spawned after the grid was built.
+	 */
+	void AddActor(AActor* Actor);
+
+	/**
+	 * Finds the indexed volumes that overlap a sphere.
+	 * @param Position			The center of the sphere.
+	 * @param Radius			The radius of the sphere.
+	 * @param OutEntries		Indices of the overlapping entries, sorted.
+	 */
+	void Query(const FVector& Position, float Radius, TArray<int32>& OutEntries) const;
+
+	/**
+	 * Finds when a sphere moving along a segment first touches the bounds of an indexed volume.
+	 * @param Start				Where the sphere starts.
+	 * @param End				Where the sphere ends.
+	 * @param Radius			The radius of the sphere.
+	 * @return					The fraction of the segment covered before touching a volume, or 1 if it touches none.
+	 */
+	float FindFirstEntry(const FVector& Start, const FVector& End, float Radius) const;
+
+	// Gets an indexed volume.
+	const FEntry& GetEntry(int32 Index) const;
+
+	// Whether a component is indexed by the grid.
+	bool Contains(const UPrimitiveComponent* Component) const;
+
+	// Whether the world has affector volumes that can move, which the grid does not index.
+	bool HasMovableAffectors() const;
+
+	// Gets the amount of indexed volumes.
+	int32 Num() const;
+
+private:
+
+	// Adds a volume to the grid, or notes that it can move.
+	void AddComponent(UPrimitiveComponent* Component);
+
+	// Gets the cell that contains a position.
+	FIntVector GetCell(const FVector& Position) const;
+
+	// The size of the grid cells.
+	float CellSize;
+
+	// The indexed volumes.
+	TArray<FEntry> Entries;
+
+	// Indices of the volumes that touch each cell.
+	TMap<FIntVector, TArray<int32>> Cells;
+
+	// The indexed components, to skip their overlap events.
+	TSet<const UPrimitiveComponent*> IndexedComponents;
+
+	// Whether the world has affector volumes that can move.
+	bool bHasMovableAffectors;
+};
@@ -4,12 +4,31 @@
 #include "LaserBase.h"
 #include "LaserBouncer.h"
 #include "LaserAffector.h"
+#include "LaserAffectorComponent.h"
+#include "LaserEffectPool.h"
+#include "LaserPool.h"
+#include "LaserReplay.h"
+#include "LaserSimulationManager.h"
+#include "LaserSteering.h"
+#include "LaserVisualsManager.h"
 #include "FMODBlueprintStatics.h"
+#include "Net/UnrealNetwork.h"
+
+DECLARE_CYCLE_STAT(TEXT("Laser NotifyHit"), STAT_LaserNotifyHit, STATGROUP_Reflect);
+DECLARE_CYCLE_STAT(TEXT("Laser Ray Cast Step"), STAT_LaserRayCastStep, STATGROUP_Reflect);
+DECLARE_CYCLE_STAT(TEXT("Laser Bounce"), STAT_LaserBounce, STATGROUP_Reflect);
+DECLARE_CYCLE_STAT(TEXT("Laser RotateVelocity"), STAT_LaserRotateVelocity, STATGROUP_Reflect);
+DECLARE_CYCLE_STAT(TEXT("Laser Steering Write Back"), STAT_LaserApplySteering, STATGROUP_Reflect);
 
 
 ALaserBase::ALaserBase(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer)
 {
-	PrimaryActorTick.bCanEverTick = true;
+	// Lasers are moved by ALaserSimulationManager instead of ticking themselves
+	PrimaryActorTick.bCanEverTick = false;
+
+	// Clients simulate lasers themselves from NetState, instead of receiving their transform every frame
+	bReplicates = true;
+	bReplicateMovement = false;
 
 	// Default values
 	InitialSpeed = 600;
@@ -17,6 +36,9 @@ ALaserBase::ALaserBase(const FObjectInitializer& ObjectInitializer) : Super(Obje
 	MaxSpeed = 800;
 	MaxBounces = 5;
 	BounceClampAngle = 5;
+	StepMode = ELaserStepMode::RayCast;
+	MaxHitsPerStep = 8;
+	LightFadeParameter = TEXT("LightFade");
 
 	InitialLifeSpan = 0;
 	NumberOfBounces = 0;
@@ -57,39 +79,174 @@ void ALaserBase::BeginPlay()
 {
 	Super::BeginPlay();
 
+	LightIntensity = LightComp->Intensity;
+
+	// Lasers warmed up by a pool wait deactivated until they are acquired
+	if (bIsPooled)
+	{
+		DeactivateLaser();
+	}
+	else
+	{
+		ActivateLaser();
+	}
+
+	// Clients can receive the laser's state before it begins play
+	if (Role < ROLE_Authority && NetState.Timestamp > 0.0f)
+	{
+		OnRep_NetState();
+	}
+}
+
+void ALaserBase::ActivateLaser()
+{
+	// Speed limits may have been changed during the laser's previous life
+	const ALaserBase* Defaults = GetClass()->GetDefaultObject<ALaserBase>();
+	MinSpeed = Defaults->MinSpeed;
+	MaxSpeed = Defaults->MaxSpeed;
+
+	NumberOfBounces = 0;
+	CarriedStepTime = 0.0f;
+	bHitQueued = false;
+	bRotationDirty = false;
+	Significance = ELaserSignificance::Full;
+	bAudioStoppedBySignificance = false;
+	LaserAffectors.Empty();
+	NativeAffectors.Empty();
+	GridAffectors.Empty();
+	bIsAlive = true;
+
+	SetActorHiddenInGame(false);
+	SetActorEnableCollision(true);
+
+	// Blueprints may play these at any time while the laser is alive
+	SetComponentAttached(ExplosionPCS, true);
+	SetComponentAttached(FirePCS, true);
+	SetComponentAttached(AudioComp, true);
+
+	// The laser visuals may draw the trail, and decide which lasers get a light
+	ALaserVisualsManager* Visuals = ALaserVisualsManager::Get(this);
+	SetLightFade(!Visuals || !Visuals->IsLimitingLights() ? 1.0f : 0.0f);
+
 	// Sets the start velocity and activates the trail particles
-	Velocity = GetActorForwardVector() * InitialSpeed;
-	TrailPCS->ActivateSystem();
+	Direction = GetActorForwardVector();
+	Speed = InitialSpeed;
+	const bool bUseTrailParticles = !Visuals || !Visuals->HasInstancedTrails();
+	SetComponentAttached(TrailPCS, bUseTrailParticles);
+	if (bUseTrailParticles)
+	{
+		TrailPCS->ActivateSystem();
+	}
 
 	// TODO: Add Fire particles, and Audio
+
+	if (ALaserSimulationManager* Manager = ALaserSimulationManager::Get(this))
+	{
+		Manager->RegisterLaser(this);
+	}
+
+	UpdateNetState();
+	ALaserReplay::NotifyLaserActivated(this);
 }
 
-void ALaserBase::Tick(float DeltaSeconds)
+void ALaserBase::DeactivateLaser()
 {
-	Super::Tick(DeltaSeconds);
+	ALaserReplay::NotifyLaserDeactivated(this);
+
+	bIsAlive = false;
+	Speed = 0.0f;
+	LaserAffectors.Empty();
+	NativeAffectors.Empty();
+	GridAffectors.Empty();
+	bHasGoal = false;
+
+	TrailPCS->DeactivateSystem();
+	TrailPCS->KillParticlesForced();
+	ExplosionPCS->DeactivateSystem();
+	ExplosionPCS->KillParticlesForced();
+	FirePCS->DeactivateSystem();
+	FirePCS->KillParticlesForced();
+	AudioComp->Stop();
+	LightComp->SetVisibility(false);
+
+	SetActorEnableCollision(false);
+	SetActorHiddenInGame(true);
+
+	// Pooled lasers are teleported around without anything of theirs being visible
+	SetComponentAttached(TrailPCS, false);
+	SetComponentAttached(ExplosionPCS, false);
+	SetComponentAttached(FirePCS, false);
+	SetComponentAttached(AudioComp, false);
+	SetComponentAttached(LightComp, false);
+
+	if (Simulation.IsValid())
+	{
+		Simulation->UnregisterLaser(this);
+	}
+
+	UpdateNetState();
+}
 
-	if (bIsAlive)
+void ALaserBase::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (Simulation.IsValid())
 	{
-		for (AActor* Affector : LaserAffectors)
-		{
-			ILaserAffector::Execute_LaserTick(Affector, this, DeltaSeconds);
-		}
+		Simulation->UnregisterLaser(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+bool ALaserBase::IsAlive() const
+{
+	return bIsAlive;
+}
+
+void ALaserBase::SetSignificance(ELaserSignificance::Type NewSignificance)
+{
+	if (Significance == NewSignificance || !bIsAlive)
+	{
+		return;
+	}
+	Significance = NewSignificance;
 
-		// Check if projectile should be killed
-		if (Velocity.SizeSquared() < FMath::Square(MinSpeed))
+	const ALaserVisualsManager* Visuals = ALaserVisualsManager::Get(this);
+	if (!Visuals || !Visuals->HasInstancedTrails())
+	{
+		// Particles already in the air finish their life, so the trail does not vanish at once
+		if (Significance == ELaserSignificance::Hidden)
 		{
-			Kill(false);
+			TrailPCS->DeactivateSystem();
 		}
-		if (NumberOfBounces > MaxBounces)
+		else if (!TrailPCS->IsActive())
 		{
-			Kill(true);
+			TrailPCS->ActivateSystem();
 		}
+	}
+
+	// With a light budget, the laser visuals give insignificant lasers no light instead
+	if (!Visuals || !Visuals->IsLimitingLights())
+	{
+		SetLightFade(Significance == ELaserSignificance::Full ? 1.0f : 0.0f);
+	}
 
-		// Adjust the location according to the velocity
-		SetActorLocation(GetActorLocation() + Velocity * DeltaSeconds, true);
+	if (Significance != ELaserSignificance::Full)
+	{
+		bAudioStoppedBySignificance |= AudioComp->IsPlaying();
+		AudioComp->Stop();
+	}
+	else if (bAudioStoppedBySignificance)
+	{
+		bAudioStoppedBySignificance = false;
+		AudioComp->Play();
 	}
 }
 
+ELaserSignificance::Type ALaserBase::GetSignificance() const
+{
+	return Significance;
+}
+
 int ALaserBase::GetNumberOfBounces() const
 {
 	return NumberOfBounces;
@@ -97,17 +254,47 @@ int ALaserBase::GetNumberOfBounces() const
 
 FVector ALaserBase::GetVelocity() const
 {
-	return Velocity;
+	return Direction * Speed;
 }
 
 void ALaserBase::NotifyHit(class UPrimitiveComponent* MyComp, AActor* Other, class UPrimitiveComponent* OtherComp, bool bSelfMoved, FVector HitLocation, FVector HitNormal, FVector NormalImpulse, const FHitResult& Hit)
 {
+	SCOPE_CYCLE_COUNTER(STAT_LaserNotifyHit);
+
 	Super::NotifyHit(MyComp, Other, OtherComp, bSelfMoved, HitLocation, HitNormal, NormalImpulse, Hit);
 
+	ALaserSimulationManager* Manager = Simulation.Get();
+	if (Manager && Manager->IsRecordingTimings())
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		HandleHit(Other, OtherComp, HitLocation, HitNormal);
+		Manager->RecordHit(FPlatformTime::Seconds() - StartTime);
+	}
+	else
+	{
+		HandleHit(Other, OtherComp, HitLocation, HitNormal);
+	}
+}
+
+void ALaserBase::HandleHit(AActor* Other, UPrimitiveComponent* OtherComp, const FVector& HitLocation, const FVector& HitNormal)
+{
+	ALaserReplay::NotifyLaserEvent(this, ELaserReplayEvent::Hit, HitNormal);
+
 	// Check if the object it collided with implements the ILaserBouncer interface
-	if (Other->GetClass()->ImplementsInterface(ULaserBouncer::StaticClass()))
+	if (ALaserSimulationManager::IsLaserBouncer(Other))
 	{
-		if (NumberOfBounces + 1 <= MaxBounces)
+		if (NumberOfBounces + 1 <= MaxBounces && Role < ROLE_Authority)
+		{
+			// Bouncers only react on the server. Clients predict a plain bounce until the server's state arrives.
+			Bounce(HitNormal, 1.0f, BounceClampAngle);
+		}
+		else if (NumberOfBounces + 1 <= MaxBounces && Simulation.IsValid() && Simulation->IsSimulating())
+		{
+			// The bouncer is called after the movement pass, instead of moving the laser from inside the hit callback
+			bHitQueued = true;
+			Simulation->QueueHit(this, Other, OtherComp, HitLocation, HitNormal);
+		}
+		else if (NumberOfBounces + 1 <= MaxBounces)
 		{
 			// Call ILaserBouncer's OnHit function
 			ILaserBouncer::Execute_LaserHit(Other, this, HitNormal);
@@ -123,153 +310,321 @@ void ALaserBase::NotifyHit(class UPrimitiveComponent* MyComp, AActor* Other, cla
 	}
 }
 
-void ALaserBase::Bounce(FVector HitNormal, float BounceSpeed, float ClampAngle)
+FVector ALaserBase::StepRayCast(const FVector& Start, float DeltaSeconds, const FLaserSweep* FirstSweep)
 {
-	FVector ReflectedVelocity = BounceSpeed * (-2 * FVector::DotProduct(Velocity, HitNormal) * HitNormal + Velocity);
+	SCOPE_CYCLE_COUNTER(STAT_LaserRayCastStep);
 
-	// Clamp angle to improve user's shots
-	if (ClampAngle != 0.0f)
+	FVector Position = Start;
+	float RemainingTime = DeltaSeconds + CarriedStepTime;
+	CarriedStepTime = 0.0f;
+
+	for (int32 HitCount = 0; bIsAlive && RemainingTime > 0.0f; HitCount++)
 	{
-		ReflectedVelocity = ClampVectorAngle(ReflectedVelocity, HitNormal, ClampAngle);
+		if (HitCount >= MaxHitsPerStep)
+		{
+			// Continue next step instead of losing the rest of the movement, up to a step's worth
+			CarriedStepTime = FMath::Min(RemainingTime, DeltaSeconds);
+			break;
+		}
+
+		const FVector End = Position + Direction * (Speed * RemainingTime);
+
+		// The sweep traced ahead of time is only valid if the laser did not change since
+		FHitResult Hit;
+		bool bBlocked;
+		if (HitCount == 0 && FirstSweep && FirstSweep->End == End)
+		{
+			bBlocked = FirstSweep->bBlocked;
+			Hit = FirstSweep->Hit;
+		}
+		else
+		{
+			bBlocked = SweepStep(Position, End, Hit);
+		}
+
+		if (!bBlocked)
+		{
+			return End;
+		}
+
+		// Pull back slightly, so the next trace does not start inside the surface
+		RemainingTime *= 1.0f - Hit.Time;
+		Position = Hit.Location + Hit.Normal * 0.1f;
+
+		// Bouncers and explosions expect the laser to be at the hit
+		SetActorLocation(Position, false);
+
+		// Dispatches the hit like a sweep would, which calls NotifyHit and lets the bouncer reflect the laser
+		CollisionComp->DispatchBlockingHit(*this, Hit);
+
+		// Queued hits are resolved after every laser moved, and the laser catches up next step.
+		// A laser that bounces every step would otherwise carry more time each step than it can use up.
+		if (bHitQueued)
+		{
+			CarriedStepTime = FMath::Min(RemainingTime, DeltaSeconds);
+			break;
+		}
 	}
 
-	Velocity = ReflectedVelocity;
-	ReflectedVelocity.Normalize();
-	SetActorRotation(ReflectedVelocity.Rotation());
+	return Position;
+}
+
+FVector ALaserBase::GetStepEnd(const FVector& Start, float DeltaSeconds) const
+{
+	return Start + Direction * (Speed * (DeltaSeconds + CarriedStepTime));
+}
+
+bool ALaserBase::SweepStep(const FVector& Start, const FVector& End, FHitResult& OutHit) const
+{
+	FCollisionShape Shape;
+	ECollisionChannel Channel;
+	FCollisionQueryParams QueryParams;
+	FCollisionResponseParams ResponseParams;
+	GetSweepSettings(Shape, Channel, QueryParams, ResponseParams);
+
+	return GetWorld()->SweepSingleByChannel(OutHit, Start, End, FQuat::Identity, Channel, Shape, QueryParams, ResponseParams);
+}
+
+void ALaserBase::GetSweepSettings(FCollisionShape& OutShape, ECollisionChannel& OutChannel, FCollisionQueryParams& OutQueryParams, FCollisionResponseParams& OutResponseParams) const
+{
+	static const FName LaserStepName(TEXT("LaserStep"));
+
+	OutShape = FCollisionShape::MakeSphere(CollisionComp->GetScaledSphereRadius());
+	OutChannel = CollisionComp->GetCollisionObjectType();
+	OutQueryParams = FCollisionQueryParams(LaserStepName, false, this);
+	OutResponseParams = FCollisionResponseParams(CollisionComp->GetCollisionResponseToChannels());
+}
+
+void ALaserBase::Bounce(FVector HitNormal, float BounceSpeed, float ClampAngle)
+{
+	SCOPE_CYCLE_COUNTER(STAT_LaserBounce);
+	ALaserReplay::NotifyLaserEvent(this, ELaserReplayEvent::Bounce, HitNormal, BounceSpeed, ClampAngle);
+
+	SetDirectionAndSpeed(ReflectVelocity(Direction * Speed, HitNormal, BounceSpeed, ClampAngle));
+	MarkRotationDirty();
 	NumberOfBounces++;
+	UpdateSimulationState();
+
+	if (Simulation.IsValid())
+	{
+		Simulation->RecordBounce();
+	}
 }
 
 void ALaserBase::Kill(bool Explode)
 {
+	if (!bIsAlive)
+	{
+		return;
+	}
+
+	ALaserReplay::NotifyLaserEvent(this, ELaserReplayEvent::Kill, GetActorLocation(), Explode ? 1.0f : 0.0f);
+
 	if (Explode)
 	{
-		ExplosionPCS->ActivateSystem();
-		Velocity = FVector::ZeroVector;
-		bIsAlive = false;
-		LightComp->DestroyComponent();
-		CollisionComp->DestroyComponent();
-		TrailPCS->DeactivateSystem();
-		FTimerHandle DeathHandle;
-		//UFMODBlueprintStatics::PlayEventAtLocation(this, LaserExplosionEvent, GetTransform(), true);
-		GetWorld()->GetTimerManager().SetTimer(DeathHandle, this, &ALaserBase::DestroyLaser, 2.0f, false);
-		OnExplode();
+		// The explosion is played by the shared effect pool, so the laser can be recycled right away
+		if (ALaserEffectPool* EffectPool = ALaserEffectPool::Get(this))
+		{
+			EffectPool->SpawnExplosion(ExplosionPCS->Template ? ExplosionPCS->Template : ExplosionFX, LaserExplosionEvent, GetActorLocation());
+		}
+
+		// Gameplay reactions to the explosion only run on the server
+		if (Role == ROLE_Authority)
+		{
+			OnExplode();
+		}
 	}
-	else
+
+	DestroyLaser();
+}
+
+void ALaserBase::SetLightFade(float Fade)
+{
+	LightFade = Fade;
+	LightComp->SetIntensity(LightIntensity * Fade);
+	LightComp->SetVisibility(Fade > 0.0f);
+	SetComponentAttached(LightComp, Fade > 0.0f);
+
+	// Setting material parameters creates dynamic instances and updates their render state, so only steps of the fade are passed on
+	const float MaterialFade = FMath::RoundToFloat(Fade * MaterialLightFadeSteps) / MaterialLightFadeSteps;
+	if (!LightFadeParameter.IsNone() && MaterialFade != MaterialLightFade)
 	{
-		DestroyLaser();
+		MaterialLightFade = MaterialFade;
+
+		TInlineComponentArray<UMeshComponent*> Meshes(this);
+		for (UMeshComponent* Mesh : Meshes)
+		{
+			Mesh->SetScalarParameterValueOnMaterials(LightFadeParameter, MaterialFade);
+		}
+		TrailPCS->SetFloatParameter(LightFadeParameter, MaterialFade);
 	}
 }
 
 void ALaserBase::DestroyLaser()
 {
-	Destroy();
+	// Clients predict the death by hiding the laser. The server releases or destroys it, which replicates.
+	if (Role < ROLE_Authority)
+	{
+		DeactivateLaser();
+	}
+	else if (OwningPool.IsValid())
+	{
+		OwningPool->ReleaseLaser(this);
+	}
+	else
+	{
+		// Effects and callbacks that run until the actor is gone must not see a live laser
+		bIsAlive = false;
+		Destroy();
+	}
 }
 
 void ALaserBase::OnBeginOverlap(UPrimitiveComponent* OverlappedComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
 {
+	// Volumes in the affector grid are found by the laser simulation
+	ALaserSimulationManager* Manager = ALaserSimulationManager::Find(this);
+	if (!Manager || !Manager->GetAffectorGrid().Contains(OtherComp))
+	{
+		BeginAffectorOverlap(OtherActor, OtherComp);
+	}
+}
+
+void ALaserBase::OnEndOverlap(UPrimitiveComponent* OverlappedComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex)
+{
+	ALaserSimulationManager* Manager = ALaserSimulationManager::Find(this);
+	if (!Manager || !Manager->GetAffectorGrid().Contains(OtherComp))
+	{
+		EndAffectorOverlap(OtherActor, OtherComp);
+	}
+}
+
+void ALaserBase::BeginAffectorOverlap(AActor* OtherActor, UPrimitiveComponent* OtherComp)
+{
+	// Native affector components are ticked directly by the laser simulation
+	if (ULaserAffectorComponent* NativeAffector = Cast<ULaserAffectorComponent>(OtherComp))
+	{
+		ILaserAffector::Execute_LaserBeginOverlap(NativeAffector, this);
+		ALaserReplay::NotifyLaserEvent(this, ELaserReplayEvent::AffectorBegin, GetActorLocation());
+
+		NativeAffectors.Add(NativeAffector);
+		UpdateSimulationState();
+	}
 	// Check if the object it overlaps with implements the ILaserAffector interface
-	if (OtherActor->GetClass()->ImplementsInterface(ULaserAffector::StaticClass()))
+	else if (ALaserSimulationManager::IsLaserAffector(OtherActor))
 	{
 		// Call ILaserAffector's OnBeginOverlap function
 		ILaserAffector::Execute_LaserBeginOverlap(OtherActor, this);
+		ALaserReplay::NotifyLaserEvent(this, ELaserReplayEvent::AffectorBegin, GetActorLocation());
 
 		LaserAffectors.Add(OtherActor);
+		UpdateSimulationState();
 	}
 }
 
-void ALaserBase::OnEndOverlap(UPrimitiveComponent* OverlappedComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex)
+void ALaserBase::EndAffectorOverlap(AActor* OtherActor, UPrimitiveComponent* OtherComp)
 {
+	if (ULaserAffectorComponent* NativeAffector = Cast<ULaserAffectorComponent>(OtherComp))
+	{
+		ILaserAffector::Execute_LaserEndOverlap(NativeAffector, this);
+		ALaserReplay::NotifyLaserEvent(this, ELaserReplayEvent::AffectorEnd, GetActorLocation());
+
+		NativeAffectors.RemoveSingleSwap(NativeAffector);
+		UpdateSimulationState();
+	}
 	// Check if the object it overlaps with implements the ILaserAffector interface
-	if (OtherActor->GetClass()->ImplementsInterface(ULaserAffector::StaticClass()))
+	else if (ALaserSimulationManager::IsLaserAffector(OtherActor))
 	{
 		// Call ILaserAffector's OnEndOverlap function
 		ILaserAffector::Execute_LaserEndOverlap(OtherActor, this);
+		ALaserReplay::NotifyLaserEvent(this, ELaserReplayEvent::AffectorEnd, GetActorLocation());
 
 		LaserAffectors.Remove(OtherActor);
+		UpdateSimulationState();
 	}
 }
 
 void ALaserBase::RotateVelocity(FVector NewDirection, float MaxAngle)
 {
-	MaxAngle = FMath::Clamp(MaxAngle, 0.0f, 180.0f);
-	
-	const FVector NormalizedVelocity = Velocity.GetSafeNormal();
-	const FVector NormalizedNewDirection = NewDirection.GetSafeNormal();
-	const float Angle = FMath::RadiansToDegrees(FMath::Acos(FVector::DotProduct(NormalizedVelocity, NormalizedNewDirection)));
+	SCOPE_CYCLE_COUNTER(STAT_LaserRotateVelocity);
+	ALaserReplay::NotifyLaserEvent(this, ELaserReplayEvent::RotateVelocity, NewDirection, MaxAngle);
 
-	// Snap direction to target direction if the current angle is smaller than max angle
-	if (Angle <= MaxAngle)
-	{
-		Velocity = NormalizedNewDirection * Velocity.Size();
-	}
-	else
-	{
-		FVector Orthogonal = FVector::CrossProduct(NormalizedVelocity, NormalizedNewDirection).GetSafeNormal();
-		if (Orthogonal.Equals(FVector::ZeroVector))
-		{
-			Orthogonal = FVector::UpVector;
-		}
-		
-		Velocity = Velocity.RotateAngleAxis(FMath::Sign(Angle) * MaxAngle, Orthogonal);
-	}
-	SetActorRotation(Velocity.Rotation());
+	float SinMaxAngle;
+	float CosMaxAngle;
+	FMath::SinCos(&SinMaxAngle, &CosMaxAngle, FMath::DegreesToRadians(FMath::Clamp(MaxAngle, 0.0f, 180.0f)));
+
+	FLaserSteering::TurnTowards(Direction, NewDirection.GetSafeNormal(), CosMaxAngle, SinMaxAngle);
+	MarkRotationDirty();
+	UpdateSimulationState();
 }
 
 void ALaserBase::AddForce(FVector ForceDirection, float Intensity)
 {
-	Velocity = Velocity + ForceDirection.GetSafeNormal() * Intensity;
+	ALaserReplay::NotifyLaserEvent(this, ELaserReplayEvent::AddForce, ForceDirection, Intensity);
 
-	if (Velocity.SizeSquared() > FMath::Square(MaxSpeed))
-	{
-		Velocity = Velocity.GetSafeNormal() * MaxSpeed;
-	}
-	SetActorRotation(Velocity.Rotation());
+	SetDirectionAndSpeed(Direction * Speed + ForceDirection.GetSafeNormal() * Intensity);
+	Speed = FMath::Min(Speed, MaxSpeed);
+	MarkRotationDirty();
+	UpdateSimulationState();
 }
 
 float ALaserBase::GetSpeed() const
 {
-	return Velocity.Size();
+	return Speed;
 }
 
 float ALaserBase::GetSquaredSpeed() const
 {
-	return Velocity.SizeSquared();
+	return Speed * Speed;
 }
 
 void ALaserBase::SetVelocity(FVector NewVelocity)
 {
-	if (NewVelocity.SizeSquared() < FMath::Square(MaxSpeed))
-	{
-		Velocity = NewVelocity;
-	}
-	else
-	{
-		Velocity = NewVelocity.GetSafeNormal() * MaxSpeed;
-	}
-	SetActorRotation(Velocity.Rotation());
+	ALaserReplay::NotifyLaserEvent(this, ELaserReplayEvent::SetVelocity, NewVelocity);
+
+	SetDirectionAndSpeed(NewVelocity);
+	Speed = FMath::Min(Speed, MaxSpeed);
+	MarkRotationDirty();
+	UpdateSimulationState();
 }
 
 void ALaserBase::SetSpeed(float NewSpeed)
 {
-	if (NewSpeed < MaxSpeed)
-	{
-		Velocity = Velocity.GetSafeNormal() * NewSpeed;
-	}
-	else
+	ALaserReplay::NotifyLaserEvent(this, ELaserReplayEvent::SetSpeed, FVector::ZeroVector, NewSpeed);
+
+	// A negative speed reverses the projectile
+	if (NewSpeed < 0.0f)
 	{
-		Velocity = Velocity.GetSafeNormal() * MaxSpeed;
+		Direction = -Direction;
+		NewSpeed = -NewSpeed;
 	}
-	SetActorRotation(Velocity.Rotation());
+	Speed = FMath::Min(NewSpeed, MaxSpeed);
+	MarkRotationDirty();
+	UpdateSimulationState();
 }
 
 void ALaserBase::SetMaxSpeed(float NewMaxSpeed)
 {
 	MaxSpeed = NewMaxSpeed;
+	UpdateSimulationState();
 }
 
 void ALaserBase::SetMinSpeed(float NewMinSpeed)
 {
 	MinSpeed = NewMinSpeed;
+	UpdateSimulationState();
+}
+
+FVector ALaserBase::ReflectVelocity(const FVector& InVelocity, const FVector& HitNormal, float BounceSpeed, float ClampAngle)
+{
+	FVector ReflectedVelocity = BounceSpeed * (-2 * FVector::DotProduct(InVelocity, HitNormal) * HitNormal + InVelocity);
+
+	// Clamp angle to improve user's shots
+	if (ClampAngle != 0.0f)
+	{
+		ReflectedVelocity = ClampVectorAngle(ReflectedVelocity, HitNormal, ClampAngle);
+	}
+
+	return ReflectedVelocity;
 }
 
 //FORCEINLINE
@@ -292,18 +647,180 @@ FVector ALaserBase::ClampVectorAngle(FVector InVector, FVector ForwardVector, in
 
 void ALaserBase::SetGoalDirection(FVector NewGoalDirection, float TransitionTime)
 {
+	ALaserReplay::NotifyLaserEvent(this, ELaserReplayEvent::SetGoalDirection, NewGoalDirection, TransitionTime);
+
 	GoalDirection = NewGoalDirection.GetSafeNormal();
-	TotalGoalAngle = FMath::RadiansToDegrees(FMath::Acos(FVector::DotProduct(GoalDirection, Velocity.GetSafeNormal())));
-	GoalTransitionTime = TransitionTime;
 
-	GetWorld()->GetTimerManager().SetTimer(GoalTimer, this, &ALaserBase::MoveTowardsGoal, GoalMovementTick, true);
+	// Turning at a constant rate covers the whole angle in the transition time
+	const float TotalGoalAngle = FMath::Acos(FMath::Clamp(FVector::DotProduct(GoalDirection, Direction), -1.0f, 1.0f));
+	GoalTurnRate = TransitionTime > 0.0f ? TotalGoalAngle / TransitionTime : BIG_NUMBER;
+
+	// The laser simulation turns the laser on every fixed step, see ApplySteering
+	bHasGoal = true;
+	UpdateSimulationState();
+}
+
+void ALaserBase::SetDirectionAndSpeed(const FVector& NewVelocity)
+{
+	Speed = NewVelocity.Size();
+	if (Speed > SMALL_NUMBER)
+	{
+		Direction = NewVelocity / Speed;
+	}
+}
+
+void ALaserBase::ApplySteering(const FVector& NewDirection, bool bReachedGoal)
+{
+	SCOPE_CYCLE_COUNTER(STAT_LaserApplySteering);
+
+	Direction = NewDirection;
+	MarkRotationDirty();
+
+	if (bReachedGoal)
+	{
+		bHasGoal = false;
+		UpdateSimulationState();
+	}
+}
+
+void ALaserBase::MarkRotationDirty()
+{
+	bRotationDirty = true;
+
+	// Only simulated lasers have their rotation updated at the end of the frame
+	if (SimulationIndex == INDEX_NONE)
+	{
+		UpdateRotation();
+	}
+}
+
+void ALaserBase::UpdateRotation()
+{
+	if (bRotationDirty)
+	{
+		bRotationDirty = false;
+		SetActorRotation(Direction.Rotation());
+	}
+}
+
+void ALaserBase::SetComponentAttached(USceneComponent* Component, bool bAttached)
+{
+	if (bAttached)
+	{
+		FLaserDetachedComponent Detached;
+		if (DetachedComponents.RemoveAndCopyValue(Component, Detached) && Detached.Parent.IsValid())
+		{
+			Component->SetRelativeTransform(Detached.RelativeTransform);
+			Component->AttachToComponent(Detached.Parent.Get(), FAttachmentTransformRules::KeepRelativeTransform, Detached.SocketName);
+		}
+	}
+	else if (Component->GetAttachParent())
+	{
+		FLaserDetachedComponent& Detached = DetachedComponents.Add(Component);
+		Detached.Parent = Component->GetAttachParent();
+		Detached.SocketName = Component->GetAttachSocketName();
+		Detached.RelativeTransform = Component->GetRelativeTransform();
+
+		// Left where it was, instead of moving to its relative offset from the world origin
+		Component->DetachFromComponent(FDetachmentTransformRules::KeepWorldTransform);
+	}
+}
+
+void ALaserBase::UpdateSimulationState()
+{
+	if (Simulation.IsValid())
+	{
+		Simulation->UpdateLaserState(this);
+	}
+
+	UpdateNetState();
+}
+
+void ALaserBase::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(ALaserBase, NetState);
+}
+
+void ALaserBase::UpdateNetState()
+{
+	if (Role != ROLE_Authority || GetNetMode() == NM_Standalone)
+	{
+		return;
+	}
+
+	NetState.Location = GetActorLocation();
+	NetState.Direction = Direction;
+	NetState.Speed = Speed;
+	NetState.Bounces = FMath::Min(NumberOfBounces, 255);
+	NetState.bIsAlive = bIsAlive;
+	NetState.Timestamp = GetNetTime();
+}
+
+void ALaserBase::OnRep_NetState()
+{
+	// Pooled lasers are reused by the server instead of being respawned
+	if (NetState.bIsAlive && !bIsAlive)
+	{
+		ActivateLaser();
+	}
+	else if (!NetState.bIsAlive)
+	{
+		if (bIsAlive)
+		{
+			DeactivateLaser();
+		}
+		return;
+	}
+
+	Direction = NetState.Direction;
+	Speed = NetState.Speed;
+	NumberOfBounces = NetState.Bounces;
+	CarriedStepTime = 0.0f;
+	UpdateSimulationState();
+
+	// The state is as old as the time it took to arrive, and the laser kept moving in a straight line since
+	const float Latency = FMath::Max(GetNetTime() - NetState.Timestamp, 0.0f);
+	SetActorLocationAndRotation(NetState.Location + Direction * (Speed * Latency), Direction.Rotation());
+	bRotationDirty = false;
+
+	if (Simulation.IsValid())
+	{
+		Simulation->TeleportLaser(this);
+	}
+}
+
+float ALaserBase::GetNetTime() const
+{
+	const UWorld* World = GetWorld();
+	const AGameStateBase* GameState = World->GetGameState();
+	return GameState ? GameState->GetServerWorldTimeSeconds() : World->GetTimeSeconds();
 }
 
-void ALaserBase::MoveTowardsGoal()
+bool FLaserNetState::NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess)
 {
-	RotateVelocity(GoalDirection, GoalMovementTick / GoalTransitionTime * TotalGoalAngle);
-	if (GoalDirection.Equals(Velocity.GetSafeNormal()))
+	bOutSuccess = SerializePackedVector<10, 24>(Location, Ar);
+	bOutSuccess &= SerializeFixedVector<1, 16>(Direction, Ar);
+
+	uint16 QuantizedSpeed = 0;
+	if (Ar.IsSaving())
+	{
+		QuantizedSpeed = (uint16)FMath::Clamp(FMath::RoundToInt(Speed), 0, (int32)MAX_uint16);
+	}
+	Ar << QuantizedSpeed;
+
+	uint8 bAlive = bIsAlive ? 1 : 0;
+	Ar.SerializeBits(&bAlive, 1);
+	Ar << Bounces;
+	Ar << Timestamp;
+
+	if (Ar.IsLoading())
 	{
-		GetWorld()->GetTimerManager().ClearTimer(GoalTimer);
+		Speed = QuantizedSpeed;
+		bIsAlive = bAlive != 0;
+		Direction = Direction.GetSafeNormal();
 	}
+
+	return true;
 }
@@ -6,17 +6,133 @@
 #include "FMODEvent.h"
 #include "LaserBase.generated.h"
 
+UENUM()
+enum class ELaserStepMode : uint8
+{
+	// Moves with a swept SetActorLocation, and bounces when the sweep calls NotifyHit.
+	Swept,
+
+	// Traces along the whole movement of a frame, and bounces as many times as needed within it.
+	RayCast
+};
+
+namespace ELaserSignificance
+{
+	enum Type : uint8
+	{
+		// Near a player or something that matters to gameplay, with every effect.
+		Full,
+
+		// On screen but far away, without a light or audio.
+		Reduced,
+
+		// Seen by nobody, and without any effects.
+		Hidden,
+
+		Num
+	};
+}
+
+/**
+ * The result of the first sweep of a ray cast step, traced ahead of time.
+ */
+struct FLaserSweep
+{
+	// Where the sweep ended, if it did not hit anything.
+	FVector End;
+
+	// The blocking hit, if there was one.
+	FHitResult Hit;
+
+	// Whether the sweep hit something.
+	bool bBlocked;
+};
+
+/**
+ * Where a component of a pooled laser was attached before it was detached, so it can be attached back the same way.
+ */
+struct FLaserDetachedComponent
+{
+	// The component it was attached to.
+	TWeakObjectPtr<USceneComponent> Parent;
+
+	// The socket it was attached at.
+	FName SocketName;
+
+	// Its transform relative to the socket.
+	FTransform RelativeTransform;
+};
+
+/**
+ * The movement state of a laser, replicated when it changes instead of every frame.
+ * Clients simulate the laser themselves in between, so bandwidth grows with bounces rather than frames.
+ */
+USTRUCT()
+struct FLaserNetState
+{
+	GENERATED_USTRUCT_BODY()
+
+	// Where the laser was when the state changed. Sent with 0.1 units of precision.
+	UPROPERTY()
+	FVector Location;
+
+	// The normalized direction of the laser. Sent as 16 bits per component.
+	UPROPERTY()
+	FVector Direction;
+
+	// The speed of the laser. Sent as whole units per second, up to 65535.
+	UPROPERTY()
+	float Speed;
+
+	// The amount of times the laser has bounced, saturating at 255.
+	UPROPERTY()
+	uint8 Bounces;
+
+	// Whether the laser is alive, as pooled lasers are deactivated instead of destroyed.
+	UPROPERTY()
+	bool bIsAlive;
+
+	// The server world time the state changed at.
+	UPROPERTY()
+	float Timestamp;
+
+	FLaserNetState()
+		: Location(FVector::ZeroVector)
+		, Direction(FVector::ForwardVector)
+		, Speed(0.0f)
+		, Bounces(0)
+		, bIsAlive(false)
+		, Timestamp(0.0f)
+	{
+	}
+
+	// Writes or reads the quantized state.
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FLaserNetState> : public TStructOpsTypeTraitsBase
+{
+	enum
+	{
+		WithNetSerializer = true
+	};
+};
+
 UCLASS()
 class REFLECT_API ALaserBase : public AActor
 {
 	GENERATED_UCLASS_BODY()
 
-	// Called every frame.
-	virtual void Tick(float DeltaSeconds) override;
-
 	// Called when the object is spawned.
 	virtual void BeginPlay() override;
 
+	// Called when the object is destroyed.
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	// Registers the replicated properties.
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
 	// Called when a blocking hit is detected.
 	virtual void NotifyHit(class UPrimitiveComponent* MyComp, AActor* Other, class UPrimitiveComponent* OtherComp, bool bSelfMoved, FVector HitLocation, FVector HitNormal, FVector NormalImpulse, const FHitResult& Hit) override;
 
@@ -43,6 +159,14 @@ class REFLECT_API ALaserBase : public AActor
 	UPROPERTY(EditDefaultsOnly, Category = "Laser")
 	UFMODEvent* LaserExplosionEvent;
 
+	// How the laser moves and finds the objects it collides with.
+	UPROPERTY(EditDefaultsOnly, Category = "Laser|Collision")
+	ELaserStepMode StepMode;
+
+	// The maximum amount of collisions handled in a single frame when using ray cast stepping.
+	UPROPERTY(EditDefaultsOnly, Category = "Laser|Collision", meta = (ClampMin = "1"))
+	int32 MaxHitsPerStep;
+
 	// Called when the projectile starts overlapping another object.
 	UFUNCTION()
 	void OnBeginOverlap(UPrimitiveComponent* OverlappedComp, AActor* Other, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
@@ -58,7 +182,16 @@ class REFLECT_API ALaserBase : public AActor
 	 * @param ClampAngle		The angle to clamp to.
 	 */
 	UFUNCTION()
-	FVector ClampVectorAngle(FVector InVector, FVector ForwardVector, int ClampAngle);
+	static FVector ClampVectorAngle(FVector InVector, FVector ForwardVector, int ClampAngle);
+
+	/**
+	 * Reflects a velocity off a surface, the same way Bounce does.
+	 * @param InVelocity		The incoming velocity.
+	 * @param HitNormal			The normal vector of the impact.
+	 * @param BounceSpeed		The relative speed after the bounce.
+	 * @param ClampAngle		Clamps the reflected angle in multiples of this.
+	 */
+	static FVector ReflectVelocity(const FVector& InVelocity, const FVector& HitNormal, float BounceSpeed, float ClampAngle);
 
 	/***************************************/
 	/* Components                          */
@@ -68,7 +201,7 @@ class REFLECT_API ALaserBase : public AActor
 	UPROPERTY(VisibleDefaultsOnly)
 	UParticleSystemComponent* TrailPCS;
 
-	// Explosion particle system component
+	// Explosion particle system component. Its template is played by ALaserEffectPool when the laser explodes
 	UPROPERTY(VisibleDefaultsOnly)
 	UParticleSystemComponent* ExplosionPCS;
 
@@ -88,6 +221,10 @@ class REFLECT_API ALaserBase : public AActor
 	UPROPERTY(EditDefaultsOnly, Category = "Laser|Light")
 	UPointLightComponent* LightComp;
 
+	// Material and particle parameter set to how much of the light is on, so the laser can glow brighter while its light is off.
+	UPROPERTY(EditDefaultsOnly, Category = "Laser|Light")
+	FName LightFadeParameter;
+
 	// Trail particle system
 	UPROPERTY(EditDefaultsOnly, Category = "Laser|Effects")
 	UParticleSystem* TrailFX;
@@ -172,7 +309,7 @@ class REFLECT_API ALaserBase : public AActor
 	void Bounce(FVector HitNormal, float BounceSpeed = 1.0f, float ClampAngle = 0.0f);
 
 	/**
-	* Kills the projectile.
+	* Kills the projectile. Does nothing if it is already dead.
 	* @param Explode			Determines whether the kill should create exploding particles
 	*/
 	UFUNCTION(BlueprintCallable, Category = "Laser")
@@ -205,41 +342,221 @@ class REFLECT_API ALaserBase : public AActor
 	UFUNCTION(BlueprintImplementableEvent, Category = "Laser")
 	void OnExplode();
 
+	/***************************************/
+	/* Pooling                             */
+	/***************************************/
+
+	/**
+	 * Resets the laser to its spawn state and starts moving it along its forward vector.
+	 * Called from BeginPlay, and by ALaserPool when a pooled laser is acquired.
+	 */
+	void ActivateLaser();
+
+	// Stops the laser and deactivates its components, so it can wait in a pool without being destroyed.
+	void DeactivateLaser();
+
+	// Whether the laser is currently alive.
+	bool IsAlive() const;
+
+	/***************************************/
+	/* Significance                        */
+	/***************************************/
+
+	/**
+	 * Turns the effects of the laser on or off to match how significant it is to the players.
+	 * @param NewSignificance	The new significance of the laser.
+	 */
+	void SetSignificance(ELaserSignificance::Type NewSignificance);
+
+	// Gets how significant the laser is to the players.
+	ELaserSignificance::Type GetSignificance() const;
+
 	/***************************************/
 	/* Inaccessible members                */
 	/***************************************/
 
 private:
 
-	// Updates the velocity of the laser, to move towards the goal
-	void MoveTowardsGoal();
+	/**
+	 * Sets the direction and speed of the laser from a velocity.
+	 * @param NewVelocity		The new velocity of the laser.
+	 */
+	void SetDirectionAndSpeed(const FVector& NewVelocity);
+
+	/**
+	 * Applies a direction that the laser simulation turned towards the goal.
+	 * @param NewDirection		The turned direction.
+	 * @param bReachedGoal		Whether the direction reached the goal.
+	 */
+	void ApplySteering(const FVector& NewDirection, bool bReachedGoal);
+
+	// Copies the movement state of the laser into the laser simulation, and into the replicated state on servers.
+	void UpdateSimulationState();
+
+	// Marks the actor rotation as out of date. Simulated lasers get it updated once per frame, by the simulation.
+	void MarkRotationDirty();
+
+	// Rotates the actor along Direction, if it changed since the actor was last rotated.
+	void UpdateRotation();
+
+	/**
+	 * Attaches a component back to its parent on the laser while it is needed, and detaches it otherwise, so it skips the laser's transform updates.
+	 * @param Component			The component of the laser.
+	 * @param bAttached			Whether the component should follow the laser.
+	 */
+	void SetComponentAttached(USceneComponent* Component, bool bAttached);
+
+	// Where the components detached by SetComponentAttached were attached.
+	TMap<USceneComponent*, FLaserDetachedComponent> DetachedComponents;
+
+	/***************************************/
+	/* Replication                         */
+	/***************************************/
+
+	// Copies the movement state of the laser into NetState, if it is replicated by this machine.
+	void UpdateNetState();
+
+	// Applies the movement state received from the server, moving the laser to where it should be by now.
+	UFUNCTION()
+	void OnRep_NetState();
+
+	// Gets the world time shared by the server and clients.
+	float GetNetTime() const;
+
+	// The movement state sent to clients.
+	UPROPERTY(ReplicatedUsing = OnRep_NetState)
+	FLaserNetState NetState;
+
+	/**
+	 * Moves the laser by tracing along its velocity, and bounces off everything it hits on the way.
+	 * @param Start				The position the laser starts moving from.
+	 * @param DeltaSeconds		Amount of time to move the laser.
+	 * @param FirstSweep		The first sweep, if it was traced ahead of time. Ignored if the laser changed since.
+	 * @return					The position the laser ended up at.
+	 */
+	FVector StepRayCast(const FVector& Start, float DeltaSeconds, const FLaserSweep* FirstSweep = nullptr);
+
+	/**
+	 * Gets where the first sweep of the next ray cast step ends.
+	 * @param Start				The position the laser starts moving from.
+	 * @param DeltaSeconds		Amount of time to move the laser.
+	 */
+	FVector GetStepEnd(const FVector& Start, float DeltaSeconds) const;
+
+	/**
+	 * Sweeps the collision of the laser. Safe to call from worker threads while nothing moves.
+	 * @param Start				The start of the sweep.
+	 * @param End				The end of the sweep.
+	 * @param OutHit			The blocking hit, if there is one.
+	 * @return					Whether the sweep hit something.
+	 */
+	bool SweepStep(const FVector& Start, const FVector& End, FHitResult& OutHit) const;
+
+	// Gets the shape, channel and parameters the laser sweeps with.
+	void GetSweepSettings(FCollisionShape& OutShape, ECollisionChannel& OutChannel, FCollisionQueryParams& OutQueryParams, FCollisionResponseParams& OutResponseParams) const;
+
+	/**
+	 * Bounces the laser if it hit a bouncer, and kills it otherwise.
+	 * While the simulation is stepping, bouncer hits are queued and resolved once every laser has moved.
+	 * @param Other				The actor the laser collided with.
+	 * @param OtherComp			The component the laser collided with.
+	 * @param HitLocation		Where the laser collided.
+	 * @param HitNormal			The normal vector of the impact.
+	 */
+	void HandleHit(AActor* Other, UPrimitiveComponent* OtherComp, const FVector& HitLocation, const FVector& HitNormal);
+
+	/**
+	 * Starts applying an affector to the laser.
+	 * @param OtherActor		The actor that owns the affector volume.
+	 * @param OtherComp			The affector volume the laser entered.
+	 */
+	void BeginAffectorOverlap(AActor* OtherActor, UPrimitiveComponent* OtherComp);
+
+	/**
+	 * Stops applying an affector to the laser.
+	 * @param OtherActor		The actor that owns the affector volume.
+	 * @param OtherComp			The affector volume the laser left.
+	 */
+	void EndAffectorOverlap(AActor* OtherActor, UPrimitiveComponent* OtherComp);
 
 	// Array of affectors that the laser is currently overlapping.
 	TArray<AActor*> LaserAffectors;
 
+	// Array of native affector components that the laser is currently overlapping.
+	TArray<class ULaserAffectorComponent*> NativeAffectors;
+
+	// Sorted indices of the affector grid volumes that the laser is currently overlapping.
+	TArray<int32> GridAffectors;
+
 	// Amount of times the projectile has bounced.
 	int NumberOfBounces;
 
-	// The current velocity of the projectile.
-	FVector Velocity;
+	// The normalized direction the projectile moves in. Kept while the projectile is stopped.
+	FVector Direction;
+
+	// The current speed of the projectile.
+	float Speed;
+
+	// Movement time left over from the last step, when it hit more objects than MaxHitsPerStep or its hit was queued. At most a step long.
+	float CarriedStepTime = 0.0f;
+
+	// Whether the laser hit a bouncer this step, and waits for the simulation to resolve the hit.
+	bool bHitQueued = false;
+
+	// Whether the actor rotation no longer matches Direction.
+	bool bRotationDirty = false;
+
+	// How significant the laser is to the players, set by ALaserSignificanceManager.
+	ELaserSignificance::Type Significance = ELaserSignificance::Full;
+
+	// Whether the audio was playing when the laser lost its full significance, so it is played again once the laser is significant.
+	bool bAudioStoppedBySignificance = false;
 
 	// The goal's normalized direction vector
 	FVector GoalDirection;
 
-	// The time it takes for the laser to redirect towards the goal
-	float GoalTransitionTime;
+	// How fast the laser turns towards the goal, in radians per second
+	float GoalTurnRate;
 
-	// The total amount of angle between the starting direction, and the goal direction
-	float TotalGoalAngle;
+	// Whether the laser is turning towards the goal direction
+	bool bHasGoal = false;
 
-	// How often the velocity is updated in MoveTowardsGoal()
-	const float GoalMovementTick = 1.0f / 144.0f;
+	bool bIsAlive = true;
 
-	// Handles the goal updates
-	FTimerHandle GoalTimer;
+	// Whether the laser is currently stored in a pool, waiting to be acquired.
+	bool bIsPooled = false;
 
-	bool bIsAlive = true;
+	// The pool this laser is returned to instead of being destroyed.
+	TWeakObjectPtr<class ALaserPool> OwningPool;
+
+	// The simulation that moves this laser.
+	TWeakObjectPtr<class ALaserSimulationManager> Simulation;
+
+	// Index of the laser in the simulation's arrays, or INDEX_NONE if it is not simulated.
+	int32 SimulationIndex = INDEX_NONE;
 
 	void DestroyLaser();
 
+	/**
+	 * Fades the light of the laser in or out.
+	 * @param Fade				How much of the light is on, from 0 to 1.
+	 */
+	void SetLightFade(float Fade);
+
+	// How much of the light is on, from 0 to 1.
+	float LightFade = 1.0f;
+
+	// The light fade last passed to the materials and trail, or -1 if it has not been passed yet.
+	float MaterialLightFade = -1.0f;
+
+	// The amount of steps the light fade of the materials and trail is rounded to, so fading does not set their parameters every frame.
+	static const int32 MaterialLightFadeSteps = 16;
+
+	// The intensity of the light when it is fully on.
+	float LightIntensity = 0.0f;
+
+	friend class ALaserPool;
+	friend class ALaserSimulationManager;
+	friend class ALaserVisualsManager;
+
 };
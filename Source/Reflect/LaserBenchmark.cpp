@@ -0,0 +1,367 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Reflect.h"
+#include "LaserBenchmark.h"
+#include "LaserBase.h"
+#include "LaserPool.h"
+#include "LaserSimulationManager.h"
+#include "LaserForceFieldComponent.h"
+#include "LaserSpeedZoneComponent.h"
+#include "LaserSteeringZoneComponent.h"
+#include "LaserGravityWellComponent.h"
+
+
+ALaserBenchmark::ALaserBenchmark(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer)
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	RootComponent = ObjectInitializer.CreateDefaultSubobject<USceneComponent>(this, TEXT("Root"));
+	RootComponent->SetMobility(EComponentMobility::Static);
+
+	// Default values
+	LaserClass = FStringClassReference(TEXT("/Game/Base/Blueprints/BP_Laser_01.BP_Laser_01_C"));
+	BouncerClass = FStringClassReference(TEXT("/Game/Base/Blueprints/BP_LaserBouncer_01.BP_LaserBouncer_01_C"));
+	LaserCounts.Add(100);
+	LaserCounts.Add(1000);
+	LaserCounts.Add(10000);
+	WarmUpFrames = 60;
+	NumFrames = 600;
+	RoomExtent = FVector(2000.0f, 2000.0f, 500.0f);
+	NumAffectors = 16;
+	AffectorExtent = FVector(200.0f, 200.0f, 200.0f);
+	Seed = 1337;
+	bQuitWhenDone = false;
+
+	PassIndex = 0;
+	PassFrame = 0;
+	PassStartTime = 0.0;
+	PassRespawns = 0;
+}
+
+void ALaserBenchmark::BeginPlay()
+{
+	Super::BeginPlay();
+
+	Random.Initialize(Seed);
+
+	LoadedLaserClass = LaserClass.TryLoadClass<ALaserBase>();
+	if (!LoadedLaserClass)
+	{
+		UE_LOG(LogReflect, Warning, TEXT("Laser benchmark could not load %s, using ALaserBase."), *LaserClass.ToString());
+		LoadedLaserClass = ALaserBase::StaticClass();
+	}
+
+	BuildRoom();
+
+	UE_LOG(LogReflect, Display, TEXT("Laser benchmark started: %d passes of %d frames."), LaserCounts.Num(), NumFrames);
+}
+
+void ALaserBenchmark::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// The world may be tearing down, so a missing simulation is not spawned again
+	if (ALaserSimulationManager* Manager = ALaserSimulationManager::Find(this))
+	{
+		Manager->SetRecordTimings(false);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ALaserBenchmark::BuildRoom()
+{
+	UWorld* World = GetWorld();
+	const FVector Center = GetActorLocation();
+
+	// A bouncer for each wall, scaled to cover it
+	if (UClass* LoadedBouncerClass = BouncerClass.TryLoadClass<AActor>())
+	{
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			for (float Side = -1.0f; Side <= 1.0f; Side += 2.0f)
+			{
+				AActor* Wall = World->SpawnActor<AActor>(LoadedBouncerClass, FTransform(Center));
+				if (!Wall)
+				{
+					continue;
+				}
+
+				FVector Origin;
+				FVector Extent;
+				Wall->GetActorBounds(false, Origin, Extent);
+				if (Extent.GetMin() <= KINDA_SMALL_NUMBER)
+				{
+					Wall->Destroy();
+					continue;
+				}
+
+				// The wall keeps its thickness, and covers the room along the other axes
+				FVector WallExtent = RoomExtent;
+				WallExtent[Axis] = Extent[Axis];
+				Wall->SetActorScale3D(Wall->GetActorScale3D() * WallExtent / Extent);
+
+				FVector WallCenter = Center;
+				WallCenter[Axis] += Side * (RoomExtent[Axis] + Extent[Axis]);
+				Wall->GetActorBounds(false, Origin, Extent);
+				Wall->AddActorWorldOffset(WallCenter - Origin);
+
+				Walls.Add(Wall);
+			}
+		}
+	}
+	else
+	{
+		UE_LOG(LogReflect, Warning, TEXT("Laser benchmark could not load %s, the room has no walls."), *BouncerClass.ToString());
+	}
+
+	// Every kind of native affector, spread around the room
+	UClass* AffectorClasses[] =
+	{
+		ULaserForceFieldComponent::StaticClass(),
+		ULaserSpeedZoneComponent::StaticClass(),
+		ULaserSteeringZoneComponent::StaticClass(),
+		ULaserGravityWellComponent::StaticClass(),
+	};
+
+	for (int32 i = 0; i < NumAffectors; i++)
+	{
+		ULaserAffectorComponent* Affector = NewObject<ULaserAffectorComponent>(this, AffectorClasses[i % ARRAY_COUNT(AffectorClasses)]);
+		Affector->SetMobility(EComponentMobility::Static);
+		Affector->SetBoxExtent(AffectorExtent);
+		Affector->SetWorldLocationAndRotation(Center + RoomExtent * FVector(Random.FRandRange(-1.0f, 1.0f), Random.FRandRange(-1.0f, 1.0f), Random.FRandRange(-1.0f, 1.0f)), FRotator(0.0f, Random.FRandRange(0.0f, 360.0f), 0.0f));
+		Affector->RegisterComponent();
+		Affectors.Add(Affector);
+	}
+
+	// The affector grid was built before the room existed. A simulation spawned later builds it with the room.
+	if (ALaserSimulationManager* Manager = ALaserSimulationManager::Find(this))
+	{
+		Manager->RebuildAffectorGrid();
+	}
+}
+
+void ALaserBenchmark::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	ALaserSimulationManager* Manager = ALaserSimulationManager::Get(this);
+	if (!Manager || !LaserCounts.IsValidIndex(PassIndex))
+	{
+		return;
+	}
+
+	// Lasers that died are replaced, so every measured frame simulates the same amount of lasers
+	const int32 NumLasersBefore = Manager->GetNumLasers();
+	TopUpLasers(LaserCounts[PassIndex]);
+	PassRespawns += Manager->GetNumLasers() - NumLasersBefore;
+
+	if (PassFrame == WarmUpFrames)
+	{
+		Manager->SetRecordTimings(true);
+		PassStartTime = FPlatformTime::Seconds();
+		PassRespawns = 0;
+	}
+	else if (PassFrame == WarmUpFrames + NumFrames)
+	{
+		RecordPass(FPlatformTime::Seconds() - PassStartTime);
+		Manager->SetRecordTimings(false);
+		KillLasers();
+
+		PassIndex++;
+		PassFrame = 0;
+		if (!LaserCounts.IsValidIndex(PassIndex))
+		{
+			Finish();
+		}
+		return;
+	}
+
+	PassFrame++;
+}
+
+void ALaserBenchmark::TopUpLasers(int32 NumLasers)
+{
+	ALaserSimulationManager* Manager = ALaserSimulationManager::Get(this);
+	const FVector Center = GetActorLocation();
+	const FVector SpawnExtent = RoomExtent * 0.9f;
+
+	for (int32 i = Manager->GetNumLasers(); i < NumLasers; i++)
+	{
+		const FVector Location = Center + SpawnExtent * FVector(Random.FRandRange(-1.0f, 1.0f), Random.FRandRange(-1.0f, 1.0f), Random.FRandRange(-1.0f, 1.0f));
+		ALaserPool::SpawnLaser(this, LoadedLaserClass, FTransform(Random.GetUnitVector().Rotation(), Location));
+	}
+}
+
+void ALaserBenchmark::KillLasers()
+{
+	for (TActorIterator<ALaserBase> It(GetWorld()); It; ++It)
+	{
+		if (It->IsAlive())
+		{
+			It->Kill(false);
+		}
+	}
+}
+
+void ALaserBenchmark::RecordPass(double Seconds)
+{
+	const FLaserSimulationTimings& Timings = ALaserSimulationManager::Get(this)->GetTimings();
+	const double MsPerFrame = 1000.0 / NumFrames;
+	const double SimulationTime = Timings.SteeringTime + Timings.GridOverlapTime + Timings.AffectorTime + Timings.KillTime + Timings.MovementTime;
+
+	if (Results.Num() == 0)
+	{
+		Results.Add(TEXT("Lasers,Frames,FrameMs,SimulationMs,StepsPerFrame,SteeringMs,GridOverlapMs,AffectorMs,KillMs,MovementMs,HitMs,HitsPerFrame,AffectorCallsPerFrame,RespawnsPerFrame"));
+	}
+
+	const FString Line = FString::Printf(TEXT("%d,%d,%.4f,%.4f,%.2f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.2f,%.2f,%.2f"),
+		LaserCounts[PassIndex], NumFrames, Seconds * MsPerFrame, SimulationTime * MsPerFrame, (double)Timings.Steps / NumFrames,
+		Timings.SteeringTime * MsPerFrame, Timings.GridOverlapTime * MsPerFrame, Timings.AffectorTime * MsPerFrame,
+		Timings.KillTime * MsPerFrame, Timings.MovementTime * MsPerFrame, Timings.HitTime * MsPerFrame,
+		(double)Timings.Hits / NumFrames, (double)Timings.AffectorCalls / NumFrames, (double)PassRespawns / NumFrames);
+
+	Results.Add(Line);
+	UE_LOG(LogReflect, Display, TEXT("Laser benchmark: %s"), *Line);
+}
+
+void ALaserBenchmark::Finish()
+{
+	const FString Path = OutputFile.IsEmpty() ? FPaths::ProfilingDir() / TEXT("LaserBenchmark.csv") : OutputFile;
+	if (FFileHelper::SaveStringToFile(FString::Join(Results, LINE_TERMINATOR) + LINE_TERMINATOR, *Path))
+	{
+		UE_LOG(LogReflect, Display, TEXT("Laser benchmark results written to %s"), *Path);
+	}
+	else
+	{
+		UE_LOG(LogReflect, Error, TEXT("Laser benchmark could not write %s"), *Path);
+	}
+
+	for (AActor* Wall : Walls)
+	{
+		if (Wall)
+		{
+			Wall->Destroy();
+		}
+	}
+	Walls.Empty();
+
+	if (bQuitWhenDone)
+	{
+		FPlatformMisc::RequestExit(false);
+	}
+	else
+	{
+		Destroy();
+	}
+}
+
+/***************************************/
+/* Console command                     */
+/***************************************/
+
+namespace
+{
+	void BenchmarkLasers(const TArray<FString>& Args, UWorld* World)
+	{
+		if (!World)
+		{
+			return;
+		}
+
+		ALaserBenchmark* Benchmark = World->SpawnActorDeferred<ALaserBenchmark>(ALaserBenchmark::StaticClass(), FTransform::Identity);
+		if (!Benchmark)
+		{
+			return;
+		}
+
+		if (Args.Num() > 0)
+		{
+			TArray<FString> Counts;
+			// -ExecCmds splits commands on commas, so counts are joined with plus signs
+			Args[0].ParseIntoArray(Counts, TEXT("+"));
+
+			Benchmark->LaserCounts.Reset();
+			for (const FString& Count : Counts)
+			{
+				Benchmark->LaserCounts.Add(FMath::Max(1, FCString::Atoi(*Count)));
+			}
+		}
+		if (Args.Num() > 1)
+		{
+			Benchmark->NumFrames = FMath::Max(1, FCString::Atoi(*Args[1]));
+		}
+		Benchmark->bQuitWhenDone = Args.Contains(TEXT("quit"));
+
+		Benchmark->FinishSpawning(FTransform::Identity);
+	}
+
+	FAutoConsoleCommandWithWorldAndArgs BenchmarkLasersCommand(
+		TEXT("Reflect.BenchmarkLasers"),
+		TEXT("Runs the laser benchmark in the current map and writes the results as CSV. Arguments: [LaserCounts, e.g. 100+1000+10000] [NumFrames] [quit]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchmarkLasers));
+}
+
+/***************************************/
+/* Automation test                     */
+/***************************************/
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLaserBenchmarkTest, "Reflect.Lasers.Benchmark", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FLaserBenchmarkTest::RunTest(const FString& Parameters)
+{
+	// A short pass in an empty game world, ticked by hand
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false);
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+	const FURL URL;
+	World->SetGameMode(URL);
+	World->InitializeActorsForPlay(URL);
+	World->BeginPlay();
+
+	const FString Path = FPaths::AutomationTransientDir() / TEXT("LaserBenchmark.csv");
+	IFileManager::Get().Delete(*Path, false, false, true);
+
+	const int32 NumLasers = 10;
+	const int32 NumFrames = 10;
+	ALaserBenchmark* Benchmark = World->SpawnActorDeferred<ALaserBenchmark>(ALaserBenchmark::StaticClass(), FTransform::Identity);
+	Benchmark->LaserCounts.Reset();
+	Benchmark->LaserCounts.Add(NumLasers);
+	Benchmark->WarmUpFrames = 2;
+	Benchmark->NumFrames = NumFrames;
+	Benchmark->OutputFile = Path;
+	Benchmark->FinishSpawning(FTransform::Identity);
+
+	// The benchmark destroys itself once it has written its results
+	for (int32 Frame = 0; Frame < 100 && !Benchmark->IsPendingKill(); Frame++)
+	{
+		World->Tick(LEVELTICK_All, 1.0f / 60.0f);
+	}
+	TestTrue(TEXT("The benchmark finished"), Benchmark->IsPendingKill());
+
+	TArray<FString> Lines;
+	FFileHelper::LoadANSITextFileToStrings(*Path, &IFileManager::Get(), Lines);
+	Lines.RemoveAll([](const FString& Line) { return Line.IsEmpty(); });
+
+	if (TestEqual(TEXT("Result lines"), Lines.Num(), 2))
+	{
+		TArray<FString> Header;
+		TArray<FString> Values;
+		Lines[0].ParseIntoArray(Header, TEXT(","));
+		Lines[1].ParseIntoArray(Values, TEXT(","));
+
+		if (TestEqual(TEXT("Result columns"), Values.Num(), Header.Num()))
+		{
+			TestEqual(TEXT("Lasers"), FCString::Atoi(*Values[Header.IndexOfByKey(TEXT("Lasers"))]), NumLasers);
+			TestEqual(TEXT("Frames"), FCString::Atoi(*Values[Header.IndexOfByKey(TEXT("Frames"))]), NumFrames);
+			TestTrue(TEXT("Frame time is measured"), FCString::Atof(*Values[Header.IndexOfByKey(TEXT("FrameMs"))]) > 0.0f);
+			TestTrue(TEXT("Simulation steps are counted"), FCString::Atof(*Values[Header.IndexOfByKey(TEXT("StepsPerFrame"))]) > 0.0f);
+		}
+	}
+
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+	return true;
+}
+
+#endif
@@ -0,0 +1,121 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "GameFramework/Actor.h"
+#include "LaserBenchmark.generated.h"
+
+class ALaserBase;
+class ULaserAffectorComponent;
+
+/**
+ * Fills a room of bouncers and affectors with lasers, and measures how long frames take.
+ * Runs a pass for every laser count, keeping that many lasers alive, and writes the results as CSV.
+ * Can be placed in a map, or spawned into any map with the Reflect.BenchmarkLasers console command. Laser counts are joined with plus signs, as -ExecCmds splits on commas, e.g.
+ * UE4Editor Reflect.uproject test -game -nullrhi -benchmark -fps=60 -ExecCmds="Reflect.BenchmarkLasers 100+1000+10000 600 quit"
+ */
+UCLASS()
+class REFLECT_API ALaserBenchmark : public AActor
+{
+	GENERATED_UCLASS_BODY()
+
+	// Called when the object is spawned.
+	virtual void BeginPlay() override;
+
+	// Called when the object is destroyed.
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	// Called every frame.
+	virtual void Tick(float DeltaSeconds) override;
+
+	// The laser that is fired.
+	UPROPERTY(EditAnywhere, Category = "Benchmark", meta = (MetaClass = "LaserBase"))
+	FStringClassReference LaserClass;
+
+	// The bouncer the walls of the room are made of. Scaled to cover a whole wall.
+	UPROPERTY(EditAnywhere, Category = "Benchmark", meta = (MetaClass = "Actor"))
+	FStringClassReference BouncerClass;
+
+	// The amount of lasers kept alive in each pass.
+	UPROPERTY(EditAnywhere, Category = "Benchmark")
+	TArray<int32> LaserCounts;
+
+	// The amount of frames that run before measuring a pass.
+	UPROPERTY(EditAnywhere, Category = "Benchmark", meta = (ClampMin = "0"))
+	int32 WarmUpFrames;
+
+	// The amount of frames measured in a pass.
+	UPROPERTY(EditAnywhere, Category = "Benchmark", meta = (ClampMin = "1"))
+	int32 NumFrames;
+
+	// Half the size of the room, centered on the benchmark.
+	UPROPERTY(EditAnywhere, Category = "Benchmark")
+	FVector RoomExtent;
+
+	// The amount of affector volumes placed in the room.
+	UPROPERTY(EditAnywhere, Category = "Benchmark", meta = (ClampMin = "0"))
+	int32 NumAffectors;
+
+	// Half the size of each affector volume.
+	UPROPERTY(EditAnywhere, Category = "Benchmark")
+	FVector AffectorExtent;
+
+	// The seed for the placement of affectors and lasers, so runs can be compared.
+	UPROPERTY(EditAnywhere, Category = "Benchmark")
+	int32 Seed;
+
+	// The file the results are written to. Defaults to LaserBenchmark.csv in the profiling directory.
+	UPROPERTY(EditAnywhere, Category = "Benchmark")
+	FString OutputFile;
+
+	// Whether the game exits once every pass has run.
+	UPROPERTY(EditAnywhere, Category = "Benchmark")
+	bool bQuitWhenDone;
+
+private:
+
+	// Builds the walls and affector volumes of the room.
+	void BuildRoom();
+
+	// Spawns lasers until the amount of live lasers is reached.
+	void TopUpLasers(int32 NumLasers);
+
+	// Kills every laser in the world.
+	void KillLasers();
+
+	// Adds the measurements of the current pass to the results.
+	void RecordPass(double Seconds);
+
+	// Writes the results and ends the benchmark.
+	void Finish();
+
+	// The loaded laser class.
+	UPROPERTY()
+	TSubclassOf<ALaserBase> LoadedLaserClass;
+
+	// The walls of the room.
+	UPROPERTY()
+	TArray<AActor*> Walls;
+
+	// The affector volumes in the room.
+	UPROPERTY()
+	TArray<ULaserAffectorComponent*> Affectors;
+
+	// The results, one CSV line per pass.
+	TArray<FString> Results;
+
+	// Random stream for placing affectors and lasers.
+	FRandomStream Random;
+
+	// The pass being run.
+	int32 PassIndex;
+
+	// The amount of frames the current pass has run.
+	int32 PassFrame;
+
+	// The time the measured frames of the current pass started.
+	double PassStartTime;
+
+	// The amount of lasers spawned while measuring the current pass.
+	int32 PassRespawns;
+};
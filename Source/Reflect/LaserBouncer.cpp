@@ -12,3 +12,11 @@ ULaserBouncer::ULaserBouncer(const class FObjectInitializer& ObjectInitializer)
 }
 
 // Add default functionality here for any ILaserBouncer functions that are not pure virtual.
+void ILaserBouncer::OnLaserHits(TArrayView<const FLaserHit> Hits)
+{
+	UObject* Bouncer = _getUObject();
+	for (const FLaserHit& Hit : Hits)
+	{
+		ILaserBouncer::Execute_LaserHit(Bouncer, Hit.Laser, Hit.Normal);
+	}
+}
@@ -4,6 +4,26 @@
 
 #include "LaserBouncer.generated.h"
 
+class ALaserBase;
+
+/**
+ * A laser hitting a bouncer, queued by the laser simulation until every laser has moved.
+ */
+struct FLaserHit
+{
+	// The laser that hit the bouncer.
+	ALaserBase* Laser;
+
+	// The component of the bouncer that was hit.
+	UPrimitiveComponent* Component;
+
+	// Where the laser hit the bouncer.
+	FVector Location;
+
+	// The normal vector from the collision.
+	FVector Normal;
+};
+
 // This class does not need to be modified.
 UINTERFACE(MinimalAPI)
 class ULaserBouncer : public UInterface
@@ -28,4 +48,12 @@ public:
 	*/
 	UFUNCTION(BlueprintImplementableEvent)
 	void LaserHit(ALaserBase* Laser, FVector HitNormal);
+
+	/**
+	 * Called with every laser that hit this object in a simulation step, once all lasers have moved.
+	 * Native bouncers can override this to bounce the lasers in one pass. Calls LaserHit for each hit by default.
+	 * Only called on objects that implement the interface in C++, Blueprint bouncers get LaserHit directly.
+	 * @param Hits		The hits on this object, in the order they happened.
+	 */
+	virtual void OnLaserHits(TArrayView<const FLaserHit> Hits);
 };
@@ -0,0 +1,109 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Reflect.h"
+#include "LaserEffectPool.h"
+#include "FMODBlueprintStatics.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Laser Explosions"), STAT_LaserExplosions, STATGROUP_Reflect);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Laser Explosions Merged"), STAT_LaserExplosionsMerged, STATGROUP_Reflect);
+
+
+ALaserEffectPool::ALaserEffectPool(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer)
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	RootComponent = ObjectInitializer.CreateDefaultSubobject<USceneComponent>(this, TEXT("Root"));
+
+	// Default values
+	MaxExplosions = 32;
+	MergeRadius = 50.0f;
+	MergeTime = 0.1f;
+
+	NumPlayedExplosions = 0;
+	NumMergedExplosions = 0;
+}
+
+void ALaserEffectPool::SpawnExplosion(UParticleSystem* Template, UFMODEvent* Sound, const FVector& Location)
+{
+	const float Time = GetWorld()->GetTimeSeconds();
+
+	for (const FLaserExplosion& Explosion : Explosions)
+	{
+		if (Time - Explosion.StartTime <= MergeTime && FVector::DistSquared(Explosion.Location, Location) <= FMath::Square(MergeRadius))
+		{
+			NumMergedExplosions++;
+			INC_DWORD_STAT(STAT_LaserExplosionsMerged);
+			return;
+		}
+	}
+
+	FLaserExplosion& Explosion = GetFreeExplosion();
+	Explosion.Location = Location;
+	Explosion.StartTime = Time;
+
+	if (Template)
+	{
+		if (Explosion.Component->Template != Template)
+		{
+			Explosion.Component->SetTemplate(Template);
+		}
+		Explosion.Component->SetWorldLocation(Location);
+		Explosion.Component->ActivateSystem(true);
+	}
+
+	if (Sound)
+	{
+		UFMODBlueprintStatics::PlayEventAtLocation(this, Sound, FTransform(Location), true);
+	}
+
+	NumPlayedExplosions++;
+	INC_DWORD_STAT(STAT_LaserExplosions);
+}
+
+FLaserExplosion& ALaserEffectPool::GetFreeExplosion()
+{
+	int32 OldestIndex = INDEX_NONE;
+	for (int32 Index = 0; Index < Explosions.Num(); Index++)
+	{
+		if (!Explosions[Index].Component->IsActive())
+		{
+			return Explosions[Index];
+		}
+
+		if (OldestIndex == INDEX_NONE || Explosions[Index].StartTime < Explosions[OldestIndex].StartTime)
+		{
+			OldestIndex = Index;
+		}
+	}
+
+	if (Explosions.Num() >= MaxExplosions && OldestIndex != INDEX_NONE)
+	{
+		return Explosions[OldestIndex];
+	}
+
+	UParticleSystemComponent* Component = NewObject<UParticleSystemComponent>(this);
+	Component->bAutoActivate = false;
+	Component->bAutoDestroy = false;
+	Component->SetupAttachment(RootComponent);
+	Component->RegisterComponent();
+
+	FLaserExplosion& Explosion = Explosions[Explosions.AddDefaulted()];
+	Explosion.Component = Component;
+	return Explosion;
+}
+
+int32 ALaserEffectPool::GetNumPlayedExplosions() const
+{
+	return NumPlayedExplosions;
+}
+
+int32 ALaserEffectPool::GetNumMergedExplosions() const
+{
+	return NumMergedExplosions;
+}
+
+ALaserEffectPool* ALaserEffectPool::Get(UObject* WorldContextObject)
+{
+	static TWeakObjectPtr<ALaserEffectPool> CachedPool;
+	return GetOrSpawnWorldActor(WorldContextObject, CachedPool);
+}
@@ -0,0 +1,87 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "GameFramework/Actor.h"
+#include "LaserEffectPool.generated.h"
+
+class UFMODEvent;
+
+USTRUCT()
+struct FLaserExplosion
+{
+	GENERATED_USTRUCT_BODY()
+
+	// The emitter playing the explosion.
+	UPROPERTY()
+	UParticleSystemComponent* Component;
+
+	// Where the explosion started.
+	FVector Location;
+
+	// The world time the explosion started.
+	float StartTime;
+
+	FLaserExplosion()
+		: Component(nullptr)
+		, Location(FVector::ZeroVector)
+		, StartTime(0.0f)
+	{
+	}
+};
+
+/**
+ * Plays laser explosions on a shared set of emitters, so a laser can be recycled as soon as it explodes.
+ * The amount of explosions playing at once is capped, and explosions close to a recent one are merged into it.
+ */
+UCLASS()
+class REFLECT_API ALaserEffectPool : public AActor
+{
+	GENERATED_UCLASS_BODY()
+
+	// The maximum amount of explosions playing at once. Beyond this, the oldest explosion is restarted at the new location.
+	UPROPERTY(EditAnywhere, Category = "Laser Effects", meta = (ClampMin = "1"))
+	int32 MaxExplosions;
+
+	// Explosions closer than this to a recent explosion are merged into it.
+	UPROPERTY(EditAnywhere, Category = "Laser Effects", meta = (ClampMin = "0.0"))
+	float MergeRadius;
+
+	// How long an explosion keeps merging the explosions around it.
+	UPROPERTY(EditAnywhere, Category = "Laser Effects", meta = (ClampMin = "0.0"))
+	float MergeTime;
+
+	/**
+	 * Plays an explosion, unless a recent explosion is close enough to stand in for it.
+	 * @param Template			The particle system of the explosion. Can be null.
+	 * @param Sound				The sound of the explosion. Can be null.
+	 * @param Location			Where the explosion happens.
+	 */
+	void SpawnExplosion(UParticleSystem* Template, UFMODEvent* Sound, const FVector& Location);
+
+	// Gets the amount of explosions that were played.
+	UFUNCTION(BlueprintCallable, Category = "Laser Effects")
+	int32 GetNumPlayedExplosions() const;
+
+	// Gets the amount of explosions that were merged into another explosion.
+	UFUNCTION(BlueprintCallable, Category = "Laser Effects")
+	int32 GetNumMergedExplosions() const;
+
+	// Gets the laser effect pool of the world, spawning one if it does not exist.
+	static ALaserEffectPool* Get(UObject* WorldContextObject);
+
+private:
+
+	// Gets an emitter that is not playing, or the oldest one if every emitter is playing.
+	FLaserExplosion& GetFreeExplosion();
+
+	// The emitters, and the explosion each one played last.
+	UPROPERTY()
+	TArray<FLaserExplosion> Explosions;
+
+	// The amount of explosions that were played.
+	int32 NumPlayedExplosions;
+
+	// The amount of explosions that were merged into another explosion.
+	int32 NumMergedExplosions;
+};
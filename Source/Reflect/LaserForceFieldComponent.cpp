@@ -0,0 +1,17 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Reflect.h"
+#include "LaserForceFieldComponent.h"
+#include "LaserBase.h"
+
+
+ULaserForceFieldComponent::ULaserForceFieldComponent(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer)
+{
+	// Default values
+	Strength = 200.0f;
+}
+
+void ULaserForceFieldComponent::ApplyToLaser(ALaserBase* Laser, float DeltaSeconds)
+{
+	Laser->AddForce(GetForwardVector(), Strength * DeltaSeconds);
+}
@@ -0,0 +1,22 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "LaserAffectorComponent.h"
+#include "LaserForceFieldComponent.generated.h"
+
+/**
+ * Pushes lasers along the forward vector of the volume.
+ */
+UCLASS(ClassGroup = (Laser), meta = (BlueprintSpawnableComponent))
+class REFLECT_API ULaserForceFieldComponent : public ULaserAffectorComponent
+{
+	GENERATED_UCLASS_BODY()
+
+	// Affects a laser inside the volume.
+	virtual void ApplyToLaser(ALaserBase* Laser, float DeltaSeconds) override;
+
+	// The force applied to lasers every second, along the forward vector of the volume.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Laser")
+	float Strength;
+};
@@ -0,0 +1,24 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Reflect.h"
+#include "LaserGravityWellComponent.h"
+#include "LaserBase.h"
+
+
+ULaserGravityWellComponent::ULaserGravityWellComponent(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer)
+{
+	// Default values
+	Strength = 400.0f;
+	FalloffRadius = 500.0f;
+}
+
+void ULaserGravityWellComponent::ApplyToLaser(ALaserBase* Laser, float DeltaSeconds)
+{
+	const FVector ToCenter = GetComponentLocation() - Laser->GetActorLocation();
+	const float Falloff = FMath::Clamp(1.0f - ToCenter.Size() / FalloffRadius, 0.0f, 1.0f);
+
+	if (Falloff > 0.0f)
+	{
+		Laser->AddForce(ToCenter, Strength * Falloff * DeltaSeconds);
+	}
+}
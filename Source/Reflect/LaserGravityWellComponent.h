@@ -0,0 +1,26 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "LaserAffectorComponent.h"
+#include "LaserGravityWellComponent.generated.h"
+
+/**
+ * Pulls lasers towards the center of the volume, harder the closer they are.
+ */
+UCLASS(ClassGroup = (Laser), meta = (BlueprintSpawnableComponent))
+class REFLECT_API ULaserGravityWellComponent : public ULaserAffectorComponent
+{
+	GENERATED_UCLASS_BODY()
+
+	// Affects a laser inside the volume.
+	virtual void ApplyToLaser(ALaserBase* Laser, float DeltaSeconds) override;
+
+	// The force applied to a laser at the center every second.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Laser")
+	float Strength;
+
+	// The distance from the center at which the pull fades out.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Laser", meta = (ClampMin = "1"))
+	float FalloffRadius;
+};
@@ -0,0 +1,177 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Reflect.h"
+#include "LaserPath.h"
+#include "LaserBase.h"
+#include "LaserSimulationManager.h"
+#include "LaserReflectionGraph.h"
+
+DECLARE_CYCLE_STAT(TEXT("Laser Path Prediction"), STAT_LaserPathPrediction, STATGROUP_Reflect);
+
+FLaserPathCache::FKey::FKey(const FVector& InOrigin, const FVector& InDirection, int32 InMaxBounces, int32 InClampAngle, float InMaxDistance)
+	: MaxBounces(InMaxBounces)
+	, ClampAngle(InClampAngle)
+	, MaxDistance(FMath::RoundToInt(InMaxDistance))
+{
+	// Origins are snapped to whole units, and directions to roughly a twentieth of a degree
+	const FVector QuantizedDirection = InDirection.GetSafeNormal() * 1024.0f;
+	Origin = FIntVector(FMath::RoundToInt(InOrigin.X), FMath::RoundToInt(InOrigin.Y), FMath::RoundToInt(InOrigin.Z));
+	Direction = FIntVector(FMath::RoundToInt(QuantizedDirection.X), FMath::RoundToInt(QuantizedDirection.Y), FMath::RoundToInt(QuantizedDirection.Z));
+}
+
+const TArray<FLaserPathSegment>* FLaserPathCache::Find(const FKey& Key) const
+{
+	const FPath* Path = Paths.Find(Key);
+	if (!Path)
+	{
+		return nullptr;
+	}
+
+	// A destroyed actor may have been garbage collected, and the segment pointing at it would dangle
+	for (int32 i = 0; i < Path->Segments.Num(); i++)
+	{
+		if (Path->Segments[i].HitActor && Path->HitActors[i].Get() != Path->Segments[i].HitActor)
+		{
+			return nullptr;
+		}
+	}
+	return &Path->Segments;
+}
+
+void FLaserPathCache::Add(const FKey& Key, const TArray<FLaserPathSegment>& Segments)
+{
+	if (Paths.Num() >= MaxEntries)
+	{
+		Paths.Empty(MaxEntries);
+	}
+	FPath& Path = Paths.Add(Key);
+	Path.Segments = Segments;
+	for (const FLaserPathSegment& Segment : Segments)
+	{
+		Path.HitActors.Add(Segment.HitActor);
+	}
+}
+
+void FLaserPathCache::Invalidate()
+{
+	Paths.Empty(MaxEntries);
+}
+
+void FLaserPathCache::InvalidateInBounds(const FBox& Bounds)
+{
+	for (auto It = Paths.CreateIterator(); It; ++It)
+	{
+		for (const FLaserPathSegment& Segment : It.Value().Segments)
+		{
+			if (FMath::LineBoxIntersection(Bounds, Segment.Start, Segment.End, Segment.End - Segment.Start))
+			{
+				It.RemoveCurrent();
+				break;
+			}
+		}
+	}
+}
+
+void ULaserPathFunctions::PredictLaserPath(UObject* WorldContextObject, FVector Origin, FVector Direction, int32 MaxBounces, int32 ClampAngle, TArray<FLaserPathSegment>& OutSegments, float MaxDistance)
+{
+	SCOPE_CYCLE_COUNTER(STAT_LaserPathPrediction);
+
+	OutSegments.Reset();
+
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject);
+	if (!World)
+	{
+		return;
+	}
+
+	// Editor previews trace without the cache, so they do not spawn a simulation into the edited level
+	ALaserSimulationManager* Manager = World->IsGameWorld() ? ALaserSimulationManager::Get(World) : nullptr;
+	if (!Manager)
+	{
+		TraceLaserPath(World, Origin, Direction, MaxBounces, ClampAngle, MaxDistance, OutSegments);
+		return;
+	}
+
+	const FLaserPathCache::FKey Key(Origin, Direction, MaxBounces, ClampAngle, MaxDistance);
+	FLaserPathCache& Cache = Manager->GetPathCache();
+
+	if (const TArray<FLaserPathSegment>* CachedSegments = Cache.Find(Key))
+	{
+		OutSegments = *CachedSegments;
+	}
+	else
+	{
+		TraceLaserPath(World, Origin, Direction, MaxBounces, ClampAngle, MaxDistance, OutSegments, &Manager->GetReflectionGraph());
+		Cache.Add(Key, OutSegments);
+	}
+}
+
+void ULaserPathFunctions::TraceLaserPath(UWorld* World, const FVector& Origin, const FVector& Direction, int32 MaxBounces, int32 ClampAngle, float MaxDistance, TArray<FLaserPathSegment>& OutSegments, const FLaserReflectionGraph* Graph, const TSet<const AActor*>* Bouncers)
+{
+	// Trace like a default laser, with the same collision settings the reflection graph is built for
+	const USphereComponent* DefaultCollision = GetDefault<ALaserBase>()->CollisionComp;
+	const float Radius = DefaultCollision->GetScaledSphereRadius();
+	const FCollisionShape Shape = FCollisionShape::MakeSphere(Radius);
+	const ECollisionChannel Channel = DefaultCollision->GetCollisionObjectType();
+	const FCollisionResponseParams ResponseParams(DefaultCollision->GetCollisionResponseToChannels());
+	static const FName PredictLaserPathName(TEXT("PredictLaserPath"));
+	const FCollisionQueryParams QueryParams(PredictLaserPathName, false);
+
+	FVector Position = Origin;
+	FVector Velocity = Direction.GetSafeNormal();
+	float RemainingDistance = MaxDistance;
+	int32 NumberOfBounces = 0;
+	int32 Face = INDEX_NONE;
+
+	while (RemainingDistance > 0.0f && !Velocity.IsNearlyZero())
+	{
+		FLaserPathSegment& Segment = OutSegments[OutSegments.AddDefaulted()];
+		Segment.Start = Position;
+		Segment.End = Position + Velocity * RemainingDistance;
+
+		// Hits on static geometry come from the reflection graph, unless the graph cannot tell exactly where the path hits
+		FVector PushNormal;
+		FLaserReflectionGraph::FHit GraphHit;
+		const bool bGraphHit = Graph && Graph->IsBuilt() && Graph->Trace(Position, Velocity, RemainingDistance, Radius, Face, GraphHit);
+		if (Graph && Graph->IsBuilt() && (!bGraphHit || GraphHit.bExact))
+		{
+			if (!bGraphHit)
+			{
+				break;
+			}
+
+			Segment.End = GraphHit.Location;
+			Segment.HitNormal = GraphHit.Normal;
+			Segment.HitActor = GraphHit.Component->GetOwner();
+			RemainingDistance -= GraphHit.Distance;
+			PushNormal = GraphHit.Normal;
+			Face = GraphHit.Face;
+		}
+		else
+		{
+			FHitResult Hit;
+			if (!World->SweepSingleByChannel(Hit, Position, Segment.End, FQuat::Identity, Channel, Shape, QueryParams, ResponseParams))
+			{
+				break;
+			}
+
+			Segment.End = Hit.Location;
+			Segment.HitNormal = Hit.ImpactNormal;
+			Segment.HitActor = Hit.GetActor();
+			RemainingDistance -= Hit.Distance;
+			PushNormal = Hit.Normal;
+			Face = INDEX_NONE;
+		}
+
+		// Lasers die on anything that is not a bouncer, or when they run out of bounces
+		const bool bHitBouncer = Bouncers ? Bouncers->Contains(Segment.HitActor) : ALaserSimulationManager::IsLaserBouncer(Segment.HitActor);
+		if (!bHitBouncer || ++NumberOfBounces > MaxBounces)
+		{
+			break;
+		}
+
+		Segment.bBounces = true;
+		Velocity = ALaserBase::ReflectVelocity(Velocity, Segment.HitNormal, 1.0f, ClampAngle).GetSafeNormal();
+		Position = Segment.End + PushNormal * 0.1f;
+	}
+}
@@ -0,0 +1,140 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "Kismet/BlueprintFunctionLibrary.h"
+#include "LaserPath.generated.h"
+
+class FLaserReflectionGraph;
+
+USTRUCT(BlueprintType)
+struct FLaserPathSegment
+{
+	GENERATED_USTRUCT_BODY()
+
+	// Where the segment starts.
+	UPROPERTY(BlueprintReadOnly, Category = "Laser")
+	FVector Start;
+
+	// Where the segment ends.
+	UPROPERTY(BlueprintReadOnly, Category = "Laser")
+	FVector End;
+
+	// The normal of the surface the segment ended at, or zero if it did not hit anything.
+	UPROPERTY(BlueprintReadOnly, Category = "Laser")
+	FVector HitNormal;
+
+	// The actor the segment ended at, if any.
+	UPROPERTY(BlueprintReadOnly, Category = "Laser")
+	AActor* HitActor;
+
+	// Whether the laser bounces at the end of the segment.
+	UPROPERTY(BlueprintReadOnly, Category = "Laser")
+	bool bBounces;
+
+	FLaserPathSegment()
+		: Start(FVector::ZeroVector)
+		, End(FVector::ZeroVector)
+		, HitNormal(FVector::ZeroVector)
+		, HitActor(nullptr)
+		, bBounces(false)
+	{
+	}
+};
+
+/**
+ * Remembers predicted laser paths, so an unchanged aim does not trace again.
+ * Origins and directions are quantized, so tiny aim changes reuse the same path.
+ */
+class REFLECT_API FLaserPathCache
+{
+public:
+
+	struct FKey
+	{
+		FIntVector Origin;
+		FIntVector Direction;
+		int32 MaxBounces;
+		int32 ClampAngle;
+		int32 MaxDistance;
+
+		FKey(const FVector& InOrigin, const FVector& InDirection, int32 InMaxBounces, int32 InClampAngle, float InMaxDistance);
+
+		bool operator==(const FKey& Other) const
+		{
+			return Origin == Other.Origin && Direction == Other.Direction && MaxBounces == Other.MaxBounces && ClampAngle == Other.ClampAngle && MaxDistance == Other.MaxDistance;
+		}
+
+		friend uint32 GetTypeHash(const FKey& Key)
+		{
+			uint32 Hash = GetTypeHash(Key.Origin);
+			Hash = HashCombine(Hash, GetTypeHash(Key.Direction));
+			return HashCombine(Hash, GetTypeHash(Key.MaxBounces ^ (Key.ClampAngle << 8) ^ (Key.MaxDistance << 16)));
+		}
+	};
+
+	// Gets a cached path, or null if the path has not been predicted since the last invalidation, or an actor it hit was destroyed.
+	const TArray<FLaserPathSegment>* Find(const FKey& Key) const;
+
+	// Stores a predicted path.
+	void Add(const FKey& Key, const TArray<FLaserPathSegment>& Segments);
+
+	// Forgets every cached path.
+	void Invalidate();
+
+	// Forgets the cached paths that pass through a box.
+	void InvalidateInBounds(const FBox& Bounds);
+
+private:
+
+	// The amount of paths kept before the cache is cleared.
+	static const int32 MaxEntries = 256;
+
+	struct FPath
+	{
+		TArray<FLaserPathSegment> Segments;
+
+		// The actors the segments hit. The cache does not keep them alive, so they are checked before a path is reused.
+		TArray<TWeakObjectPtr<AActor>> HitActors;
+	};
+
+	TMap<FKey, FPath> Paths;
+};
+
+/**
+ * Predicts where a laser will go, using the same reflection math as ALaserBase::Bounce.
+ */
+UCLASS()
+class REFLECT_API ULaserPathFunctions : public UBlueprintFunctionLibrary
+{
+	GENERATED_BODY()
+
+public:
+
+	/**
+	 * Predicts the path of a laser, reusing the last prediction if nothing has changed since.
+	 * @param Origin			Where the laser is fired from.
+	 * @param Direction			The direction the laser is fired in.
+	 * @param MaxBounces		The maximum amount of bounces before the laser is killed.
+	 * @param ClampAngle		Clamps the reflected angles in multiples of this.
+	 * @param OutSegments		The straight segments of the path.
+	 * @param MaxDistance		The maximum length of the path.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Laser", meta = (WorldContext = "WorldContextObject"))
+	static void PredictLaserPath(UObject* WorldContextObject, FVector Origin, FVector Direction, int32 MaxBounces, int32 ClampAngle, TArray<FLaserPathSegment>& OutSegments, float MaxDistance = 10000.0f);
+
+	/**
+	 * Traces the path of a laser without using the cache.
+	 * @param World				The world to trace in.
+	 * @param Origin			Where the laser is fired from.
+	 * @param Direction			The direction the laser is fired in.
+	 * @param MaxBounces		The maximum amount of bounces before the laser is killed.
+	 * @param ClampAngle		Clamps the reflected angles in multiples of this.
+	 * @param MaxDistance		The maximum length of the path.
+	 * @param OutSegments		The straight segments of the path.
+	 * @param Graph				Static geometry to look hits up in before sweeping, if any.
+	 * @param Bouncers			The bouncers of the world, gathered ahead of time. Needed to trace from worker threads, which can not use the interface cache.
+	 */
+	static void TraceLaserPath(UWorld* World, const FVector& Origin, const FVector& Direction, int32 MaxBounces, int32 ClampAngle, float MaxDistance, TArray<FLaserPathSegment>& OutSegments,
+		const FLaserReflectionGraph* Graph = nullptr, const TSet<const AActor*>* Bouncers = nullptr);
+};
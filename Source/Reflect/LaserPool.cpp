@@ -0,0 +1,125 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Reflect.h"
+#include "LaserPool.h"
+#include "LaserBase.h"
+
+
+ALaserPool::ALaserPool(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer)
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	// Default values
+	WarmUpClass = ALaserBase::StaticClass();
+	WarmUpSize = 0;
+
+	PoolHits = 0;
+	PoolMisses = 0;
+}
+
+void ALaserPool::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (WarmUpClass)
+	{
+		FLaserPoolBucket& Bucket = FreeLasers.FindOrAdd(WarmUpClass);
+		Bucket.Lasers.Reserve(WarmUpSize);
+
+		for (int32 i = 0; i < WarmUpSize; i++)
+		{
+			if (ALaserBase* Laser = SpawnPooledLaser(WarmUpClass, GetActorTransform(), true))
+			{
+				Bucket.Lasers.Add(Laser);
+			}
+		}
+	}
+}
+
+ALaserBase* ALaserPool::AcquireLaser(TSubclassOf<ALaserBase> LaserClass, const FTransform& SpawnTransform)
+{
+	if (!LaserClass)
+	{
+		return nullptr;
+	}
+
+	if (FLaserPoolBucket* Bucket = FreeLasers.Find(LaserClass))
+	{
+		while (Bucket->Lasers.Num() > 0)
+		{
+			ALaserBase* Laser = Bucket->Lasers.Pop(false);
+
+			// Lasers can be destroyed while pooled, e.g. when streaming out a level
+			if (Laser && !Laser->IsPendingKill())
+			{
+				PoolHits++;
+
+				Laser->bIsPooled = false;
+				Laser->SetActorTransform(SpawnTransform, false, nullptr, ETeleportType::TeleportPhysics);
+				Laser->ActivateLaser();
+				return Laser;
+			}
+		}
+	}
+
+	PoolMisses++;
+	return SpawnPooledLaser(LaserClass, SpawnTransform, false);
+}
+
+void ALaserPool::ReleaseLaser(ALaserBase* Laser)
+{
+	if (!Laser || Laser->bIsPooled)
+	{
+		return;
+	}
+
+	Laser->DeactivateLaser();
+	Laser->bIsPooled = true;
+	Laser->OwningPool = this;
+
+	FreeLasers.FindOrAdd(Laser->GetClass()).Lasers.Add(Laser);
+}
+
+int32 ALaserPool::GetPoolHits() const
+{
+	return PoolHits;
+}
+
+int32 ALaserPool::GetPoolMisses() const
+{
+	return PoolMisses;
+}
+
+int32 ALaserPool::GetNumPooledLasers() const
+{
+	int32 NumPooled = 0;
+	for (const TPair<UClass*, FLaserPoolBucket>& Pair : FreeLasers)
+	{
+		NumPooled += Pair.Value.Lasers.Num();
+	}
+	return NumPooled;
+}
+
+ALaserBase* ALaserPool::SpawnLaser(UObject* WorldContextObject, TSubclassOf<ALaserBase> LaserClass, const FTransform& SpawnTransform)
+{
+	ALaserPool* Pool = Get(WorldContextObject);
+	return Pool ? Pool->AcquireLaser(LaserClass, SpawnTransform) : nullptr;
+}
+
+ALaserPool* ALaserPool::Get(UObject* WorldContextObject)
+{
+	static TWeakObjectPtr<ALaserPool> CachedPool;
+	return GetOrSpawnWorldActor(WorldContextObject, CachedPool);
+}
+
+ALaserBase* ALaserPool::SpawnPooledLaser(TSubclassOf<ALaserBase> LaserClass, const FTransform& SpawnTransform, bool bStartPooled)
+{
+	ALaserBase* Laser = GetWorld()->SpawnActorDeferred<ALaserBase>(LaserClass, SpawnTransform, nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+	if (Laser)
+	{
+		Laser->OwningPool = this;
+		Laser->bIsPooled = bStartPooled;
+		Laser->FinishSpawning(SpawnTransform);
+	}
+	return Laser;
+}
@@ -0,0 +1,93 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "GameFramework/Actor.h"
+#include "LaserPool.generated.h"
+
+class ALaserBase;
+
+USTRUCT()
+struct FLaserPoolBucket
+{
+	GENERATED_USTRUCT_BODY()
+
+	// Deactivated lasers of a single class, waiting to be acquired.
+	UPROPERTY()
+	TArray<ALaserBase*> Lasers;
+};
+
+/**
+ * Keeps deactivated lasers around, so firing a laser reuses an existing actor
+ * instead of spawning one and destroying it again when it dies.
+ * Place one in a map to configure how many lasers are created when the map starts.
+ */
+UCLASS()
+class REFLECT_API ALaserPool : public AActor
+{
+	GENERATED_UCLASS_BODY()
+
+	// Called when the object is spawned.
+	virtual void BeginPlay() override;
+
+	// The laser class that is spawned into the pool when the map starts.
+	UPROPERTY(EditAnywhere, Category = "Laser Pool")
+	TSubclassOf<ALaserBase> WarmUpClass;
+
+	// The amount of lasers spawned into the pool when the map starts.
+	UPROPERTY(EditAnywhere, Category = "Laser Pool", meta = (ClampMin = "0"))
+	int32 WarmUpSize;
+
+	/**
+	 * Takes a laser out of the pool and activates it, or spawns a new laser if the pool is empty.
+	 * @param LaserClass		The class of the laser.
+	 * @param SpawnTransform	The transform the laser starts at.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Laser Pool")
+	ALaserBase* AcquireLaser(TSubclassOf<ALaserBase> LaserClass, const FTransform& SpawnTransform);
+
+	/**
+	 * Deactivates a laser and stores it in the pool.
+	 * @param Laser				The laser to release.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Laser Pool")
+	void ReleaseLaser(ALaserBase* Laser);
+
+	// Gets the amount of acquired lasers that were taken from the pool.
+	UFUNCTION(BlueprintCallable, Category = "Laser Pool")
+	int32 GetPoolHits() const;
+
+	// Gets the amount of acquired lasers that had to be spawned because the pool was empty.
+	UFUNCTION(BlueprintCallable, Category = "Laser Pool")
+	int32 GetPoolMisses() const;
+
+	// Gets the amount of lasers currently waiting in the pool.
+	UFUNCTION(BlueprintCallable, Category = "Laser Pool")
+	int32 GetNumPooledLasers() const;
+
+	/**
+	 * Spawns a laser through the pool of the world, creating the pool if the map does not have one.
+	 * @param LaserClass		The class of the laser.
+	 * @param SpawnTransform	The transform the laser starts at.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Laser", meta = (WorldContext = "WorldContextObject"))
+	static ALaserBase* SpawnLaser(UObject* WorldContextObject, TSubclassOf<ALaserBase> LaserClass, const FTransform& SpawnTransform);
+
+	// Gets the laser pool of the world, spawning one if it does not exist.
+	static ALaserPool* Get(UObject* WorldContextObject);
+
+private:
+
+	// Spawns a new laser that returns to this pool when it dies.
+	ALaserBase* SpawnPooledLaser(TSubclassOf<ALaserBase> LaserClass, const FTransform& SpawnTransform, bool bStartPooled);
+
+	// Lasers waiting to be acquired, by class.
+	UPROPERTY()
+	TMap<UClass*, FLaserPoolBucket> FreeLasers;
+
+	// Amount of acquired lasers taken from the pool.
+	int32 PoolHits;
+
+	// Amount of acquired lasers that had to be spawned.
+	int32 PoolMisses;
+};
@@ -0,0 +1,468 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Reflect.h"
+#include "LaserReflectionGraph.h"
+#include "LaserBase.h"
+#include "PhysicsEngine/BodySetup.h"
+#include "Async/ParallelFor.h"
+
+FLaserReflectionGraph::FLaserReflectionGraph()
+	: Channel(ECC_Laser)
+	, Radius(0.0f)
+	, Resolution(12)
+	, bLinked(false)
+	, bBuilt(false)
+{
+}
+
+void FLaserReflectionGraph::Build(UWorld* World, int32 InResolution)
+{
+	Reset();
+	Resolution = FMath::Clamp(InResolution, 2, 64);
+
+	// Same sweeps as ALaserBase::SweepStep of a default laser
+	const USphereComponent* DefaultCollision = GetDefault<ALaserBase>()->CollisionComp;
+	Channel = DefaultCollision->GetCollisionObjectType();
+	Responses = DefaultCollision->GetCollisionResponseToChannels();
+	Radius = DefaultCollision->GetScaledSphereRadius();
+
+	for (TActorIterator<AActor> It(World); It; ++It)
+	{
+		AActor* Actor = *It;
+		if (Actor->IsA<ALaserBase>())
+		{
+			continue;
+		}
+
+		TInlineComponentArray<UPrimitiveComponent*> Components(Actor);
+		for (UPrimitiveComponent* Component : Components)
+		{
+			if (!BlocksLasers(Component))
+			{
+				continue;
+			}
+
+			if (Component->Mobility == EComponentMobility::Static)
+			{
+				AddComponent(Component);
+			}
+			else
+			{
+				DynamicBlockers.Add(Component);
+			}
+		}
+	}
+
+	LinkFaces();
+	bBuilt = true;
+}
+
+void FLaserReflectionGraph::Reset()
+{
+	Blockers.Reset();
+	FaceBinStarts.Reset();
+	FaceBinBlockers.Reset();
+	DynamicBlockers.Reset();
+	bLinked = false;
+	bBuilt = false;
+}
+
+void FLaserReflectionGraph::AddDynamicBlockers(AActor* Actor)
+{
+	if (!bBuilt || !Actor || Actor->IsA<ALaserBase>())
+	{
+		return;
+	}
+
+	TInlineComponentArray<UPrimitiveComponent*> Components(Actor);
+	for (UPrimitiveComponent* Component : Components)
+	{
+		if (BlocksLasers(Component))
+		{
+			DynamicBlockers.RemoveAllSwap([](const TWeakObjectPtr<UPrimitiveComponent>& DynamicBlocker) { return !DynamicBlocker.IsValid(); });
+			DynamicBlockers.AddUnique(Component);
+		}
+	}
+}
+
+bool FLaserReflectionGraph::BlocksLasers(const UPrimitiveComponent* Component) const
+{
+	const ECollisionEnabled::Type CollisionEnabled = Component->GetCollisionEnabled();
+	return (CollisionEnabled == ECollisionEnabled::QueryOnly || CollisionEnabled == ECollisionEnabled::QueryAndPhysics)
+		&& Component->GetCollisionResponseToChannel(Channel) == ECR_Block && Responses.GetResponse(Component->GetCollisionObjectType()) == ECR_Block;
+}
+
+void FLaserReflectionGraph::AddComponent(UPrimitiveComponent* Component)
+{
+	const FTransform& Transform = Component->GetComponentTransform();
+
+	if (const UBoxComponent* Box = Cast<UBoxComponent>(Component))
+	{
+		AddBox(Component, Transform, FTransform::Identity, Box->GetUnscaledBoxExtent(), true);
+		return;
+	}
+
+	// Sweeps use the simple collision, which is exact as long as it is only made of boxes
+	const UBodySetup* BodySetup = Component->GetBodySetup();
+	if (BodySetup && BodySetup->CollisionTraceFlag != CTF_UseComplexAsSimple
+		&& BodySetup->AggGeom.BoxElems.Num() > 0 && BodySetup->AggGeom.GetElementCount() == BodySetup->AggGeom.BoxElems.Num())
+	{
+		for (const FKBoxElem& Elem : BodySetup->AggGeom.BoxElems)
+		{
+			AddBox(Component, Transform, Elem.GetTransform(), FVector(Elem.X, Elem.Y, Elem.Z) * 0.5f, true);
+		}
+		return;
+	}
+
+	const FBox Bounds = Component->Bounds.GetBox();
+	AddBox(Component, FTransform(Bounds.GetCenter()), FTransform::Identity, Bounds.GetExtent(), false);
+}
+
+void FLaserReflectionGraph::AddBox(UPrimitiveComponent* Component, const FTransform& ComponentTransform, const FTransform& BoxTransform, const FVector& BoxExtent, bool bExact)
+{
+	FBlocker Blocker;
+	Blocker.Component = Component;
+	Blocker.Center = ComponentTransform.TransformPosition(BoxTransform.GetLocation());
+	Blocker.bExact = bExact;
+
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		FVector LocalAxis = FVector::ZeroVector;
+		LocalAxis[Axis] = 1.0f;
+		const FVector WorldAxis = ComponentTransform.TransformVector(BoxTransform.TransformVectorNoScale(LocalAxis));
+		const float Scale = WorldAxis.Size();
+		if (Scale < SMALL_NUMBER)
+		{
+			return;
+		}
+
+		Blocker.Axes[Axis] = WorldAxis / Scale;
+		Blocker.Extent[Axis] = BoxExtent[Axis] * Scale;
+	}
+
+	// Rotated boxes in a non-uniformly scaled component are skewed, so only their bounds can be used
+	const bool bOrthogonal = FMath::Abs(FVector::DotProduct(Blocker.Axes[0], Blocker.Axes[1])) < KINDA_SMALL_NUMBER
+		&& FMath::Abs(FVector::DotProduct(Blocker.Axes[1], Blocker.Axes[2])) < KINDA_SMALL_NUMBER
+		&& FMath::Abs(FVector::DotProduct(Blocker.Axes[0], Blocker.Axes[2])) < KINDA_SMALL_NUMBER;
+	if (!bOrthogonal)
+	{
+		const FBox Bounds = Component->Bounds.GetBox();
+		AddBox(Component, FTransform(Bounds.GetCenter()), FTransform::Identity, Bounds.GetExtent(), false);
+		return;
+	}
+
+	Blocker.BoundingRadius = Blocker.Extent.Size();
+	Blockers.Add(Blocker);
+}
+
+void FLaserReflectionGraph::LinkFaces()
+{
+	const int32 NumFaces = Blockers.Num() * 6;
+
+	if (Blockers.Num() > MaxLinkedBlockers)
+	{
+		UE_LOG(LogReflect, Warning, TEXT("Laser reflection graph has %d blockers, more than the %d it links faces for. Every trace will test every box."), Blockers.Num(), MaxLinkedBlockers);
+		return;
+	}
+
+	// Every face keeps a count and a start for every bin, so many boxes tell fewer directions apart
+	const int32 MaxResolution = FMath::Max(2, FMath::FloorToInt(FMath::Sqrt((float)MaxLinkedSlots / (2 * FMath::Max(NumFaces, 1)))));
+	if (Resolution > MaxResolution)
+	{
+		UE_LOG(LogReflect, Warning, TEXT("Laser reflection graph has %d blockers, too many to link faces at resolution %d. Using resolution %d instead."), Blockers.Num(), Resolution, MaxResolution);
+		Resolution = MaxResolution;
+	}
+	const int32 NumBins = 2 * Resolution * Resolution;
+
+	// Any direction in a bin is at most this far from the direction at its center
+	const float BinAngle = PI / Resolution;
+
+	TArray<FVector> BinDirections;
+	BinDirections.SetNumUninitialized(NumBins);
+	for (int32 Bin = 0; Bin < NumBins; Bin++)
+	{
+		BinDirections[Bin] = GetBinDirection(Bin);
+	}
+
+	TArray<int32> FaceBinCounts;
+	FaceBinCounts.SetNumZeroed(NumFaces * NumBins);
+	TArray<TArray<uint16>> FaceLists;
+	FaceLists.SetNum(NumFaces);
+
+	// Counted while the lists are filled, so a graph over the budget stops before it uses the memory
+	FThreadSafeCounter NumEntries;
+
+	ParallelFor(NumFaces, [&](int32 Face)
+	{
+		if (NumEntries.GetValue() > MaxLinkedEntries)
+		{
+			return;
+		}
+
+		const int32 Owner = Face / 6;
+		const FBlocker& Blocker = Blockers[Owner];
+		if (!Blocker.bExact)
+		{
+			return;
+		}
+
+		const int32 Axis = (Face % 6) / 2;
+		const FVector Normal = Face % 2 ? Blocker.Axes[Axis] : -Blocker.Axes[Axis];
+		const FVector FaceCenter = Blocker.Center + Normal * Blocker.Extent[Axis];
+
+		// How far from the center of the face a sphere leaving it can start, see IsLeavingFace
+		const float FaceReach = FVector(Blocker.Extent[(Axis + 1) % 3] + Radius + 1.0f, Blocker.Extent[(Axis + 2) % 3] + Radius + 1.0f, Radius + 1.0f).Size();
+
+		// Every box in front of the face, with the direction to it and how far a ray that hits it can deviate from that direction
+		TArray<uint16> Targets;
+		TArray<FVector> TargetDirections;
+		TArray<float> TargetMinCos;
+		for (int32 Other = 0; Other < Blockers.Num(); Other++)
+		{
+			const FBlocker& Target = Blockers[Other];
+			const FVector ToTarget = Target.Center - FaceCenter;
+			const float Reach = FaceReach + Target.BoundingRadius + Radius;
+			if (Other == Owner || FVector::DotProduct(ToTarget, Normal) + Reach < 0.0f)
+			{
+				continue;
+			}
+
+			const float Distance = ToTarget.Size();
+			Targets.Add(Other);
+			if (Distance <= Reach)
+			{
+				TargetDirections.Add(FVector::ZeroVector);
+				TargetMinCos.Add(-2.0f);
+			}
+			else
+			{
+				TargetDirections.Add(ToTarget / Distance);
+				TargetMinCos.Add(FMath::Cos(FMath::Min(PI, BinAngle + FMath::Asin(Reach / Distance))));
+			}
+		}
+
+		// Rays leave the face, so bins that point back into it are never looked up
+		const float MinFacing = -FMath::Sin(BinAngle);
+		TArray<uint16>& List = FaceLists[Face];
+		for (int32 Bin = 0; Bin < NumBins; Bin++)
+		{
+			if (FVector::DotProduct(BinDirections[Bin], Normal) < MinFacing)
+			{
+				continue;
+			}
+
+			int32& Count = FaceBinCounts[Face * NumBins + Bin];
+			for (int32 i = 0; i < Targets.Num(); i++)
+			{
+				if (FVector::DotProduct(BinDirections[Bin], TargetDirections[i]) >= TargetMinCos[i])
+				{
+					List.Add(Targets[i]);
+					Count++;
+				}
+			}
+
+			if (NumEntries.Add(Count) + Count > MaxLinkedEntries)
+			{
+				return;
+			}
+		}
+	});
+
+	if (NumEntries.GetValue() > MaxLinkedEntries)
+	{
+		UE_LOG(LogReflect, Warning, TEXT("Laser reflection graph would link more than the %d boxes to faces it keeps. Every trace will test every box."), MaxLinkedEntries);
+		return;
+	}
+
+	FaceBinStarts.SetNumUninitialized(NumFaces * NumBins + 1);
+	int32 Offset = 0;
+	for (int32 Slot = 0; Slot < NumFaces * NumBins; Slot++)
+	{
+		FaceBinStarts[Slot] = Offset;
+		Offset += FaceBinCounts[Slot];
+	}
+	FaceBinStarts[NumFaces * NumBins] = Offset;
+
+	FaceBinBlockers.Reserve(Offset);
+	for (const TArray<uint16>& List : FaceLists)
+	{
+		FaceBinBlockers.Append(List);
+	}
+
+	bLinked = true;
+}
+
+bool FLaserReflectionGraph::Trace(const FVector& Start, const FVector& Direction, float MaxDistance, float InRadius, int32 StartFace, FHit& OutHit) const
+{
+	int32 SkipBlocker = INDEX_NONE;
+	const uint16* Candidates = nullptr;
+	int32 NumCandidates = Blockers.Num();
+
+	// A sphere leaving a box can not hit the same box again, and only sees the boxes linked to the face it leaves
+	if (StartFace >= 0 && StartFace < Blockers.Num() * 6 && Blockers[StartFace / 6].bExact && IsLeavingFace(StartFace, Start, Direction, InRadius))
+	{
+		SkipBlocker = StartFace / 6;
+		if (bLinked && InRadius <= Radius + KINDA_SMALL_NUMBER)
+		{
+			const int32 Slot = StartFace * 2 * Resolution * Resolution + GetDirectionBin(Direction);
+			Candidates = FaceBinBlockers.GetData() + FaceBinStarts[Slot];
+			NumCandidates = FaceBinStarts[Slot + 1] - FaceBinStarts[Slot];
+		}
+	}
+
+	float BestDistance = MaxDistance;
+	bool bHit = false;
+
+	for (int32 i = 0; i < NumCandidates; i++)
+	{
+		const int32 Index = Candidates ? Candidates[i] : i;
+		const FBlocker& Blocker = Blockers[Index];
+		if (Index == SkipBlocker || !Blocker.Component.IsValid())
+		{
+			continue;
+		}
+
+		// Slab test against the box grown by the radius of the sphere
+		const FVector Offset = Start - Blocker.Center;
+		float EnterDistance = -BIG_NUMBER;
+		float ExitDistance = BIG_NUMBER;
+		int32 EnterAxis = 0;
+		float EnterSign = 1.0f;
+		bool bMisses = false;
+
+		for (int32 Axis = 0; Axis < 3 && !bMisses; Axis++)
+		{
+			const float Origin = FVector::DotProduct(Offset, Blocker.Axes[Axis]);
+			const float Speed = FVector::DotProduct(Direction, Blocker.Axes[Axis]);
+			const float Extent = Blocker.Extent[Axis] + InRadius;
+
+			if (FMath::Abs(Speed) < SMALL_NUMBER)
+			{
+				bMisses = FMath::Abs(Origin) > Extent;
+				continue;
+			}
+
+			const float Side = FMath::Sign(Speed);
+			const float Near = (-Side * Extent - Origin) / Speed;
+			const float Far = (Side * Extent - Origin) / Speed;
+			if (Near > EnterDistance)
+			{
+				EnterDistance = Near;
+				EnterAxis = Axis;
+				EnterSign = -Side;
+			}
+			ExitDistance = FMath::Min(ExitDistance, Far);
+			bMisses = EnterDistance > ExitDistance;
+		}
+
+		// Touching a box the sphere is already moving out of is not a hit
+		if (bMisses || EnterDistance >= BestDistance || (EnterDistance < 0.0f && ExitDistance <= 1.0f))
+		{
+			continue;
+		}
+
+		OutHit.Component = Blocker.Component.Get();
+		OutHit.Distance = FMath::Max(EnterDistance, 0.0f);
+		OutHit.Location = Start + Direction * OutHit.Distance;
+		OutHit.Normal = Blocker.Axes[EnterAxis] * EnterSign;
+		OutHit.Face = Index * 6 + EnterAxis * 2 + (EnterSign > 0.0f ? 1 : 0);
+
+		// The grown edges and corners are where the rounded shape a sweep uses differs from the box
+		const FVector HitOffset = OutHit.Location - Blocker.Center;
+		const int32 AxisU = (EnterAxis + 1) % 3;
+		const int32 AxisV = (EnterAxis + 2) % 3;
+		OutHit.bExact = Blocker.bExact && EnterDistance >= 0.0f
+			&& FMath::Abs(FVector::DotProduct(HitOffset, Blocker.Axes[AxisU])) <= Blocker.Extent[AxisU] + KINDA_SMALL_NUMBER
+			&& FMath::Abs(FVector::DotProduct(HitOffset, Blocker.Axes[AxisV])) <= Blocker.Extent[AxisV] + KINDA_SMALL_NUMBER;
+
+		BestDistance = OutHit.Distance;
+		bHit = true;
+	}
+
+	// Blockers outside the graph are only known by their bounds
+	for (const TWeakObjectPtr<UPrimitiveComponent>& DynamicBlocker : DynamicBlockers)
+	{
+		UPrimitiveComponent* Component = DynamicBlocker.Get();
+		if (!Component || !BlocksLasers(Component))
+		{
+			continue;
+		}
+
+		FVector HitLocation;
+		FVector HitNormal;
+		float HitTime;
+		if (FMath::LineExtentBoxIntersection(Component->Bounds.GetBox(), Start, Start + Direction * BestDistance, FVector(InRadius), HitLocation, HitNormal, HitTime))
+		{
+			OutHit.Component = Component;
+			OutHit.Distance = HitTime * BestDistance;
+			OutHit.Location = HitLocation;
+			OutHit.Normal = HitNormal;
+			OutHit.Face = INDEX_NONE;
+			OutHit.bExact = false;
+
+			BestDistance = OutHit.Distance;
+			bHit = true;
+		}
+	}
+
+	return bHit;
+}
+
+bool FLaserReflectionGraph::IsLeavingFace(int32 Face, const FVector& Position, const FVector& Direction, float InRadius) const
+{
+	const FBlocker& Blocker = Blockers[Face / 6];
+	const int32 Axis = (Face % 6) / 2;
+	const FVector Normal = Face % 2 ? Blocker.Axes[Axis] : -Blocker.Axes[Axis];
+	if (FVector::DotProduct(Direction, Normal) <= 0.0f)
+	{
+		return false;
+	}
+
+	// Sweeps stop slightly short of the surface, and paths start slightly off it
+	const FVector Offset = Position - Blocker.Center;
+	const int32 AxisU = (Axis + 1) % 3;
+	const int32 AxisV = (Axis + 2) % 3;
+	return FMath::Abs(FVector::DotProduct(Offset, Normal) - Blocker.Extent[Axis] - InRadius) <= 1.0f
+		&& FMath::Abs(FVector::DotProduct(Offset, Blocker.Axes[AxisU])) <= Blocker.Extent[AxisU] + InRadius + 1.0f
+		&& FMath::Abs(FVector::DotProduct(Offset, Blocker.Axes[AxisV])) <= Blocker.Extent[AxisV] + InRadius + 1.0f;
+}
+
+bool FLaserReflectionGraph::SupportsLaser(const ALaserBase* Laser) const
+{
+	const USphereComponent* Collision = Laser->CollisionComp;
+	const FCollisionResponseContainer& LaserResponses = Collision->GetCollisionResponseToChannels();
+	return bBuilt && Collision->GetCollisionObjectType() == Channel && Collision->GetScaledSphereRadius() <= Radius + KINDA_SMALL_NUMBER
+		&& FMemory::Memcmp(&LaserResponses, &Responses, sizeof(FCollisionResponseContainer)) == 0;
+}
+
+int32 FLaserReflectionGraph::GetDirectionBin(const FVector& Direction) const
+{
+	// Rows of latitude and columns of longitude, each spanning PI / Resolution
+	const float Theta = FMath::Acos(FMath::Clamp(Direction.Z, -1.0f, 1.0f));
+	const float Phi = FMath::Atan2(Direction.Y, Direction.X) + PI;
+	const int32 Row = FMath::Clamp(FMath::FloorToInt(Theta / PI * Resolution), 0, Resolution - 1);
+	const int32 Column = FMath::Clamp(FMath::FloorToInt(Phi / PI * Resolution), 0, 2 * Resolution - 1);
+	return Row * 2 * Resolution + Column;
+}
+
+FVector FLaserReflectionGraph::GetBinDirection(int32 Bin) const
+{
+	const float Theta = (Bin / (2 * Resolution) + 0.5f) * PI / Resolution;
+	const float Phi = (Bin % (2 * Resolution) + 0.5f) * PI / Resolution - PI;
+	return FVector(FMath::Sin(Theta) * FMath::Cos(Phi), FMath::Sin(Theta) * FMath::Sin(Phi), FMath::Cos(Theta));
+}
+
+const FLaserReflectionGraph::FBlocker& FLaserReflectionGraph::GetBlocker(int32 Index) const
+{
+	return Blockers[Index];
+}
+
+int32 FLaserReflectionGraph::Num() const
+{
+	return Blockers.Num();
+}
+
+bool FLaserReflectionGraph::IsBuilt() const
+{
+	return bBuilt;
+}
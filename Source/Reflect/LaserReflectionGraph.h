@@ -0,0 +1,165 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+class ALaserBase;
+
+/**
+ * Graph of the static geometry that blocks lasers, built at level load.
+ * The surfaces are the faces of collision boxes. For every face and quantized direction leaving it,
+ * the graph knows which boxes a laser could hit next, so finding the next surface is a few ray-box tests instead of a sweep.
+ * Anything the graph cannot answer exactly is reported as such, and has to be swept.
+ */
+class REFLECT_API FLaserReflectionGraph
+{
+public:
+
+	struct FBlocker
+	{
+		// The collision shape.
+		TWeakObjectPtr<UPrimitiveComponent> Component;
+
+		// World space center of the box.
+		FVector Center;
+
+		// World space axes of the box.
+		FVector Axes[3];
+
+		// Half the size of the box along each axis.
+		FVector Extent;
+
+		// Radius of a sphere around the box.
+		float BoundingRadius;
+
+		// Whether the box is the actual collision shape, instead of the bounds of a shape the graph cannot represent.
+		bool bExact;
+	};
+
+	struct FHit
+	{
+		// The component that was hit.
+		UPrimitiveComponent* Component;
+
+		// How far the sphere moved before the hit.
+		float Distance;
+
+		// Where the center of the sphere was at the hit.
+		FVector Location;
+
+		// The normal of the surface that was hit.
+		FVector Normal;
+
+		// The face that was hit, to start the next trace from.
+		int32 Face;
+
+		// Whether a sweep would find the same hit. If not, the path has to be swept.
+		bool bExact;
+	};
+
+	FLaserReflectionGraph();
+
+	/**
+	 * Indexes the static laser blockers of a world, replacing what was indexed before.
+	 * @param World				The world to index.
+	 * @param InResolution		The amount of directions the graph tells apart, along half a circle.
+	 */
+	void Build(UWorld* World, int32 InResolution);
+
+	// Removes every indexed blocker.
+	void Reset();
+
+	/**
+	 * Watches the laser blockers of an actor that was spawned after the graph was built, or that can move.
+	 * @param Actor				The actor to watch.
+	 */
+	void AddDynamicBlockers(AActor* Actor);
+
+	/**
+	 * Finds the first surface a laser sized sphere hits.
+	 * @param Start				Where the sphere starts.
+	 * @param Direction			The direction the sphere moves in, normalized.
+	 * @param MaxDistance		How far the sphere moves.
+	 * @param InRadius			The radius of the sphere. Faces are only linked for spheres up to the radius of the default laser.
+	 * @param StartFace			The face the sphere is leaving, which limits the tests to the boxes it can see, or INDEX_NONE.
+	 * @param OutHit			The first hit.
+	 * @return					Whether the sphere hits anything.
+	 */
+	bool Trace(const FVector& Start, const FVector& Direction, float MaxDistance, float InRadius, int32 StartFace, FHit& OutHit) const;
+
+	// Whether a laser sweeps the same geometry the graph was built for.
+	bool SupportsLaser(const ALaserBase* Laser) const;
+
+	// Gets an indexed blocker.
+	const FBlocker& GetBlocker(int32 Index) const;
+
+	// Gets the amount of indexed blockers.
+	int32 Num() const;
+
+	// Whether the graph has been built.
+	bool IsBuilt() const;
+
+private:
+
+	// Whether a component blocks the sweeps of the lasers the graph is built for.
+	bool BlocksLasers(const UPrimitiveComponent* Component) const;
+
+	// Adds the collision boxes of a static component, or its bounds if its shape is not made of boxes.
+	void AddComponent(UPrimitiveComponent* Component);
+
+	/**
+	 * Adds a box.
+	 * @param Component			The component the box belongs to.
+	 * @param ComponentTransform	The transform of the component.
+	 * @param BoxTransform		The transform of the box relative to the component.
+	 * @param BoxExtent			Half the size of the box, before the scale of the component.
+	 * @param bExact			Whether the box is the actual collision shape.
+	 */
+	void AddBox(UPrimitiveComponent* Component, const FTransform& ComponentTransform, const FTransform& BoxTransform, const FVector& BoxExtent, bool bExact);
+
+	// Finds the boxes each face can see in each direction.
+	void LinkFaces();
+
+	// Whether a sphere at a position touches a face, and is moving away from it.
+	bool IsLeavingFace(int32 Face, const FVector& Position, const FVector& Direction, float InRadius) const;
+
+	// Gets the direction bin of a normalized direction.
+	int32 GetDirectionBin(const FVector& Direction) const;
+
+	// Gets the direction at the center of a direction bin.
+	FVector GetBinDirection(int32 Bin) const;
+
+	// The amount of blockers faces are linked for. Bigger worlds test every box instead.
+	static const int32 MaxLinkedBlockers = 1024;
+
+	// The amount of links between faces and boxes the graph keeps, to bound its memory.
+	static const int32 MaxLinkedEntries = 16 * 1024 * 1024;
+
+	// The amount of face and direction bin pairs the graph keeps the boxes of, to bound its memory. Lowers the resolution of graphs with many boxes.
+	static const int32 MaxLinkedSlots = 4 * 1024 * 1024;
+
+	// The indexed boxes. Box i has faces 6i to 6i + 5, in the order -X, +X, -Y, +Y, -Z, +Z.
+	TArray<FBlocker> Blockers;
+
+	// Where the boxes seen from each face in each direction bin start in FaceBinBlockers, with one extra entry at the end.
+	TArray<int32> FaceBinStarts;
+
+	// The boxes seen from each face in each direction bin.
+	TArray<uint16> FaceBinBlockers;
+
+	// Blockers that are not indexed, which are tested through their bounds.
+	TArray<TWeakObjectPtr<UPrimitiveComponent>> DynamicBlockers;
+
+	// The collision settings of the default laser, which the graph is built for.
+	ECollisionChannel Channel;
+	FCollisionResponseContainer Responses;
+	float Radius;
+
+	// The amount of directions the graph tells apart, along half a circle.
+	int32 Resolution;
+
+	// Whether the faces have been linked to the boxes they can see.
+	bool bLinked;
+
+	// Whether the graph has been built.
+	bool bBuilt;
+};
@@ -0,0 +1,558 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Reflect.h"
+#include "LaserReplay.h"
+#include "LaserBase.h"
+#include "LaserPool.h"
+#include "LaserSimulationManager.h"
+
+namespace
+{
+	// Identifies laser replay files, and the version of their layout.
+	const uint32 ReplayMagic = 0x4C52504C;
+	const int32 ReplayVersion = 1;
+
+	uint64 GetSampleKey(uint32 Step, int32 LaserId)
+	{
+		return ((uint64)Step << 32) | (uint32)LaserId;
+	}
+}
+
+FArchive& operator<<(FArchive& Ar, FLaserReplayEvent& Event)
+{
+	Ar << Event.Step << Event.Type << Event.bExternal << Event.LaserId;
+
+	// Only the arguments the event has are stored
+	switch (Event.Type)
+	{
+	case ELaserReplayEvent::Spawn:
+		Ar << Event.Vector << Event.Direction << Event.Value << Event.ClassIndex;
+		break;
+	case ELaserReplayEvent::SetGoalDirection:
+	case ELaserReplayEvent::AddForce:
+	case ELaserReplayEvent::RotateVelocity:
+		Ar << Event.Vector << Event.Value;
+		break;
+	case ELaserReplayEvent::Bounce:
+		Ar << Event.Vector << Event.Value << Event.Value2;
+		break;
+	case ELaserReplayEvent::SetSpeed:
+	case ELaserReplayEvent::Kill:
+		Ar << Event.Value;
+		break;
+	default:
+		Ar << Event.Vector;
+		break;
+	}
+	return Ar;
+}
+
+FArchive& operator<<(FArchive& Ar, FLaserReplaySample& Sample)
+{
+	return Ar << Sample.Step << Sample.LaserId << Sample.Position;
+}
+
+TWeakObjectPtr<ALaserReplay> ALaserReplay::ActiveReplay;
+
+ALaserReplay::ALaserReplay(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer)
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	// Default values
+	SampleInterval = 6;
+	DivergenceTolerance = 1.0f;
+
+	Mode = ELaserReplayMode::None;
+	bQuitWhenDone = false;
+	StartStep = 0;
+	LastStep = 0;
+	FixedTimeStep = 0.0f;
+	PreviousFixedTimeStep = 0.0f;
+	NextLaserId = 0;
+	PendingSpawnId = INDEX_NONE;
+	NextEventIndex = 0;
+	NumRecordedInteractions = 0;
+	NumReplayedInteractions = 0;
+	NumComparedSamples = 0;
+	MaxDivergence = 0.0f;
+	FirstDivergentStep = MAX_uint32;
+}
+
+void ALaserReplay::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	Finish();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+ALaserReplay* ALaserReplay::StartRecording(UObject* WorldContextObject, const FString& Name)
+{
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject);
+	if (!World)
+	{
+		return nullptr;
+	}
+
+	if (ActiveReplay.IsValid())
+	{
+		ActiveReplay->Stop();
+	}
+
+	ALaserReplay* Replay = World->SpawnActor<ALaserReplay>();
+	Replay->ReplayName = Name;
+	Replay->Begin(ELaserReplayMode::Recording);
+	return Replay;
+}
+
+ALaserReplay* ALaserReplay::StartPlayback(UObject* WorldContextObject, const FString& Name, bool bQuitWhenDone)
+{
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject);
+	if (!World)
+	{
+		return nullptr;
+	}
+
+	if (ActiveReplay.IsValid())
+	{
+		ActiveReplay->Stop();
+	}
+
+	ALaserReplay* Replay = World->SpawnActor<ALaserReplay>();
+	Replay->ReplayName = Name;
+	Replay->bQuitWhenDone = bQuitWhenDone;
+	if (!Replay->Load())
+	{
+		UE_LOG(LogReflect, Error, TEXT("Could not load laser replay %s"), *GetReplayPath(Name));
+		Replay->Destroy();
+		return nullptr;
+	}
+
+	Replay->Begin(ELaserReplayMode::Playing);
+	return Replay;
+}
+
+void ALaserReplay::Begin(ELaserReplayMode::Type InMode)
+{
+	ALaserSimulationManager* Manager = ALaserSimulationManager::Get(this);
+	if (!Manager)
+	{
+		return;
+	}
+
+	Mode = InMode;
+	Simulation = Manager;
+	StartStep = Manager->GetStepCount();
+	PreStepHandle = Manager->OnPreStep.AddUObject(this, &ALaserReplay::OnPreStep);
+	ActiveReplay = this;
+
+	if (Mode == ELaserReplayMode::Recording)
+	{
+		FixedTimeStep = Manager->FixedTimeStep;
+
+		// Lasers that are already flying are recorded as if they were spawned now
+		for (ALaserBase* Laser : Manager->GetLasers())
+		{
+			if (Laser)
+			{
+				OnLaserActivated(Laser);
+			}
+		}
+	}
+	else
+	{
+		PreviousFixedTimeStep = Manager->FixedTimeStep;
+		Manager->FixedTimeStep = FixedTimeStep;
+
+		// Lasers that are already flying were not part of the recording
+		for (ALaserBase* Laser : Manager->GetLasers())
+		{
+			if (Laser)
+			{
+				SuppressedLasers.Add(Laser);
+			}
+		}
+	}
+
+	UE_LOG(LogReflect, Display, TEXT("Laser replay %s %s"), Mode == ELaserReplayMode::Recording ? TEXT("recording to") : TEXT("playing from"), *GetReplayPath(ReplayName));
+}
+
+void ALaserReplay::Stop()
+{
+	Finish();
+	Destroy();
+}
+
+void ALaserReplay::Finish()
+{
+	if (Mode == ELaserReplayMode::None)
+	{
+		return;
+	}
+
+	if (Simulation.IsValid())
+	{
+		Simulation->OnPreStep.Remove(PreStepHandle);
+	}
+	if (ActiveReplay == this)
+	{
+		ActiveReplay.Reset();
+	}
+
+	if (Mode == ELaserReplayMode::Recording)
+	{
+		LastStep = GetReplayStep();
+		if (Save())
+		{
+			UE_LOG(LogReflect, Display, TEXT("Laser replay saved to %s: %d steps, %d events, %d samples"), *GetReplayPath(ReplayName), LastStep, Events.Num(), Samples.Num());
+		}
+		else
+		{
+			UE_LOG(LogReflect, Error, TEXT("Could not save laser replay %s"), *GetReplayPath(ReplayName));
+		}
+	}
+	else
+	{
+		if (Simulation.IsValid())
+		{
+			Simulation->FixedTimeStep = PreviousFixedTimeStep;
+		}
+
+		UE_LOG(LogReflect, Display, TEXT("Laser replay %s played: %d positions compared, max divergence %.3f, first divergent step %s, %d of %d interactions happened again"),
+			*ReplayName, NumComparedSamples, MaxDivergence,
+			FirstDivergentStep == MAX_uint32 ? TEXT("none") : *FString::FromInt(FirstDivergentStep),
+			NumReplayedInteractions, NumRecordedInteractions);
+
+		if (bQuitWhenDone)
+		{
+			FPlatformMisc::RequestExit(false);
+		}
+	}
+
+	Mode = ELaserReplayMode::None;
+}
+
+void ALaserReplay::OnPreStep(uint32 Step)
+{
+	const uint32 ReplayStep = Step - StartStep;
+
+	if (Mode == ELaserReplayMode::Playing)
+	{
+		if (ReplayStep > LastStep)
+		{
+			Stop();
+			return;
+		}
+
+		for (const TWeakObjectPtr<ALaserBase>& Laser : SuppressedLasers)
+		{
+			if (Laser.IsValid())
+			{
+				Laser->Kill(false);
+			}
+		}
+		SuppressedLasers.Reset();
+
+		// Calls made between steps were recorded with the step that followed them
+		while (Events.IsValidIndex(NextEventIndex) && Events[NextEventIndex].Step <= ReplayStep)
+		{
+			const FLaserReplayEvent& Event = Events[NextEventIndex++];
+			if (Event.bExternal)
+			{
+				ApplyEvent(Event);
+			}
+		}
+	}
+
+	if (ReplayStep % SampleInterval == 0)
+	{
+		SampleLasers(ReplayStep);
+	}
+}
+
+void ALaserReplay::OnLaserActivated(ALaserBase* Laser)
+{
+	if (Laser->GetWorld() != GetWorld() || !Simulation.IsValid())
+	{
+		return;
+	}
+
+	if (Mode == ELaserReplayMode::Recording)
+	{
+		const int32 LaserId = NextLaserId++;
+		LaserIds.Add(Laser, LaserId);
+
+		FLaserReplayEvent Event;
+		Event.Step = GetReplayStep();
+		Event.Type = ELaserReplayEvent::Spawn;
+		Event.bExternal = !Simulation->IsSimulating();
+		Event.LaserId = LaserId;
+		Event.Vector = Laser->GetActorLocation();
+		Event.Direction = Laser->GetActorForwardVector();
+		Event.Value = Laser->GetSpeed();
+		Event.ClassIndex = ClassPaths.AddUnique(Laser->GetClass()->GetPathName());
+		Events.Add(Event);
+	}
+	else if (PendingSpawnId != INDEX_NONE)
+	{
+		LaserIds.Add(Laser, PendingSpawnId);
+		NextLaserId = FMath::Max(NextLaserId, PendingSpawnId + 1);
+	}
+	else if (Simulation->IsSimulating())
+	{
+		// Spawned by the simulation, e.g. by a bouncer that splits lasers, as it was in the recording
+		LaserIds.Add(Laser, NextLaserId++);
+	}
+	else
+	{
+		// The recording already contains the lasers the world spawns on its own
+		SuppressedLasers.Add(Laser);
+	}
+}
+
+void ALaserReplay::OnLaserDeactivated(const ALaserBase* Laser)
+{
+	LaserIds.Remove(Laser);
+}
+
+void ALaserReplay::OnLaserEvent(const ALaserBase* Laser, ELaserReplayEvent::Type Type, const FVector& Vector, float Value, float Value2)
+{
+	const int32* LaserId = LaserIds.Find(Laser);
+	if (!LaserId || !Simulation.IsValid())
+	{
+		return;
+	}
+
+	const bool bExternal = !Simulation->IsSimulating();
+	const bool bInteraction = Type >= ELaserReplayEvent::AffectorBegin;
+
+	if (Mode == ELaserReplayMode::Recording)
+	{
+		FLaserReplayEvent Event;
+		Event.Step = GetReplayStep();
+		Event.Type = Type;
+		Event.bExternal = bExternal && !bInteraction;
+		Event.LaserId = *LaserId;
+		Event.Vector = Vector;
+		Event.Value = Value;
+		Event.Value2 = Value2;
+		Events.Add(Event);
+	}
+	else if (bInteraction)
+	{
+		NumReplayedInteractions++;
+	}
+}
+
+void ALaserReplay::ApplyEvent(const FLaserReplayEvent& Event)
+{
+	if (Event.Type == ELaserReplayEvent::Spawn)
+	{
+		if (!Classes.IsValidIndex(Event.ClassIndex) || !Classes[Event.ClassIndex])
+		{
+			return;
+		}
+
+		PendingSpawnId = Event.LaserId;
+		ALaserBase* Laser = ALaserPool::SpawnLaser(this, Classes[Event.ClassIndex], FTransform(Event.Direction.Rotation(), Event.Vector));
+		PendingSpawnId = INDEX_NONE;
+
+		if (Laser)
+		{
+			Laser->SetSpeed(Event.Value);
+			ReplayedLasers.Add(Event.LaserId, Laser);
+		}
+		return;
+	}
+
+	const TWeakObjectPtr<ALaserBase>* ReplayedLaser = ReplayedLasers.Find(Event.LaserId);
+	ALaserBase* Laser = ReplayedLaser ? ReplayedLaser->Get() : nullptr;
+	if (!Laser)
+	{
+		return;
+	}
+
+	switch (Event.Type)
+	{
+	case ELaserReplayEvent::SetGoalDirection:
+		Laser->SetGoalDirection(Event.Vector, Event.Value);
+		break;
+	case ELaserReplayEvent::AddForce:
+		Laser->AddForce(Event.Vector, Event.Value);
+		break;
+	case ELaserReplayEvent::SetVelocity:
+		Laser->SetVelocity(Event.Vector);
+		break;
+	case ELaserReplayEvent::SetSpeed:
+		Laser->SetSpeed(Event.Value);
+		break;
+	case ELaserReplayEvent::RotateVelocity:
+		Laser->RotateVelocity(Event.Vector, Event.Value);
+		break;
+	case ELaserReplayEvent::Bounce:
+		Laser->Bounce(Event.Vector, Event.Value, Event.Value2);
+		break;
+	case ELaserReplayEvent::Kill:
+		Laser->Kill(Event.Value != 0.0f);
+		break;
+	default:
+		break;
+	}
+}
+
+void ALaserReplay::SampleLasers(uint32 Step)
+{
+	const TArray<ALaserBase*>& Lasers = Simulation->GetLasers();
+
+	for (int32 i = 0; i < Lasers.Num(); i++)
+	{
+		const int32* LaserId = Lasers[i] ? LaserIds.Find(Lasers[i]) : nullptr;
+		if (!LaserId)
+		{
+			continue;
+		}
+
+		if (Mode == ELaserReplayMode::Recording)
+		{
+			FLaserReplaySample Sample;
+			Sample.Step = Step;
+			Sample.LaserId = *LaserId;
+			Sample.Position = Simulation->GetLaserPosition(i);
+			Samples.Add(Sample);
+		}
+		else if (const FVector* RecordedPosition = RecordedPositions.Find(GetSampleKey(Step, *LaserId)))
+		{
+			const float Divergence = FVector::Dist(*RecordedPosition, Simulation->GetLaserPosition(i));
+			MaxDivergence = FMath::Max(MaxDivergence, Divergence);
+			if (Divergence > DivergenceTolerance && FirstDivergentStep == MAX_uint32)
+			{
+				FirstDivergentStep = Step;
+				UE_LOG(LogReflect, Warning, TEXT("Laser replay %s diverged at step %d: laser %d is %.3f from its recorded position"), *ReplayName, Step, *LaserId, Divergence);
+			}
+			NumComparedSamples++;
+		}
+	}
+}
+
+bool ALaserReplay::Save()
+{
+	TArray<uint8> Data;
+	FMemoryWriter Writer(Data);
+
+	uint32 Magic = ReplayMagic;
+	int32 Version = ReplayVersion;
+	FString MapName = GetWorld()->GetMapName();
+	Writer << Magic << Version << MapName << FixedTimeStep << SampleInterval << LastStep;
+	Writer << ClassPaths << Events << Samples;
+
+	return FFileHelper::SaveArrayToFile(Data, *GetReplayPath(ReplayName));
+}
+
+bool ALaserReplay::Load()
+{
+	TArray<uint8> Data;
+	if (!FFileHelper::LoadFileToArray(Data, *GetReplayPath(ReplayName)))
+	{
+		return false;
+	}
+
+	FMemoryReader Reader(Data);
+
+	uint32 Magic = 0;
+	int32 Version = 0;
+	FString MapName;
+	Reader << Magic << Version;
+	if (Magic != ReplayMagic || Version != ReplayVersion)
+	{
+		return false;
+	}
+
+	Reader << MapName << FixedTimeStep << SampleInterval << LastStep;
+	Reader << ClassPaths << Events << Samples;
+	if (Reader.IsError())
+	{
+		return false;
+	}
+
+	if (MapName != GetWorld()->GetMapName())
+	{
+		UE_LOG(LogReflect, Warning, TEXT("Laser replay %s was recorded in %s, but is played in %s"), *ReplayName, *MapName, *GetWorld()->GetMapName());
+	}
+
+	for (const FString& ClassPath : ClassPaths)
+	{
+		Classes.Add(LoadClass<ALaserBase>(nullptr, *ClassPath));
+	}
+
+	for (const FLaserReplayEvent& Event : Events)
+	{
+		if (Event.Type >= ELaserReplayEvent::AffectorBegin)
+		{
+			NumRecordedInteractions++;
+		}
+	}
+
+	for (const FLaserReplaySample& Sample : Samples)
+	{
+		RecordedPositions.Add(GetSampleKey(Sample.Step, Sample.LaserId), Sample.Position);
+	}
+
+	return true;
+}
+
+uint32 ALaserReplay::GetReplayStep() const
+{
+	return Simulation.IsValid() ? Simulation->GetStepCount() - StartStep : 0;
+}
+
+ALaserReplay* ALaserReplay::GetActive()
+{
+	return ActiveReplay.Get();
+}
+
+FString ALaserReplay::GetReplayPath(const FString& Name)
+{
+	return FPaths::GameSavedDir() / TEXT("LaserReplays") / Name + TEXT(".lrp");
+}
+
+/***************************************/
+/* Console commands                    */
+/***************************************/
+
+namespace
+{
+	void RecordLasers(const TArray<FString>& Args, UWorld* World)
+	{
+		ALaserReplay::StartRecording(World, Args.Num() > 0 ? Args[0] : FDateTime::Now().ToString());
+	}
+
+	void PlayLasers(const TArray<FString>& Args, UWorld* World)
+	{
+		if (Args.Num() > 0)
+		{
+			ALaserReplay::StartPlayback(World, Args[0], Args.Contains(TEXT("quit")));
+		}
+	}
+
+	void StopLaserReplay()
+	{
+		if (ALaserReplay* Replay = ALaserReplay::GetActive())
+		{
+			Replay->Stop();
+		}
+	}
+
+	FAutoConsoleCommandWithWorldAndArgs RecordLasersCommand(
+		TEXT("Reflect.RecordLasers"),
+		TEXT("Records the lasers of the current map until Reflect.StopLaserReplay. Arguments: [Name]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&RecordLasers));
+
+	FAutoConsoleCommandWithWorldAndArgs PlayLasersCommand(
+		TEXT("Reflect.PlayLasers"),
+		TEXT("Re-simulates a laser recording in the current map and reports where it diverges. Arguments: <Name> [quit]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&PlayLasers));
+
+	FAutoConsoleCommand StopLaserReplayCommand(
+		TEXT("Reflect.StopLaserReplay"),
+		TEXT("Stops the laser recording or playback that is running."),
+		FConsoleCommandDelegate::CreateStatic(&StopLaserReplay));
+}
@@ -0,0 +1,293 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "GameFramework/Actor.h"
+#include "LaserReplay.generated.h"
+
+class ALaserBase;
+class ALaserSimulationManager;
+
+namespace ELaserReplayEvent
+{
+	enum Type : uint8
+	{
+		// Calls on a laser, replayed when they were made outside of a simulation step
+		Spawn,
+		SetGoalDirection,
+		AddForce,
+		SetVelocity,
+		SetSpeed,
+		RotateVelocity,
+		Bounce,
+		Kill,
+
+		// Interactions caused by the simulation, only recorded to compare replays
+		AffectorBegin,
+		AffectorEnd,
+		Hit,
+	};
+}
+
+namespace ELaserReplayMode
+{
+	enum Type : uint8
+	{
+		None,
+		Recording,
+		Playing,
+	};
+}
+
+/**
+ * Something that happened to a laser during a recording.
+ */
+struct FLaserReplayEvent
+{
+	// The simulation step the event happened in, counted from the start of the recording.
+	uint32 Step;
+
+	// What happened, as ELaserReplayEvent::Type.
+	uint8 Type;
+
+	// Whether the event came from outside of the simulation, so it has to be replayed.
+	bool bExternal;
+
+	// The laser, numbered in the order lasers were activated.
+	int32 LaserId;
+
+	// The vector argument of the call, or the location of the laser.
+	FVector Vector;
+
+	// The direction a laser was spawned in.
+	FVector Direction;
+
+	// The first float argument of the call.
+	float Value;
+
+	// The second float argument of the call.
+	float Value2;
+
+	// The class a laser was spawned with, as an index into the class table of the replay.
+	int32 ClassIndex;
+
+	FLaserReplayEvent()
+	{
+		FMemory::Memzero(*this);
+	}
+
+	friend FArchive& operator<<(FArchive& Ar, FLaserReplayEvent& Event);
+};
+
+/**
+ * The position of a laser at the start of a simulation step.
+ */
+struct FLaserReplaySample
+{
+	uint32 Step;
+	int32 LaserId;
+	FVector Position;
+
+	friend FArchive& operator<<(FArchive& Ar, FLaserReplaySample& Sample);
+};
+
+/**
+ * Records the lasers of a world to a compact binary file, keyed by simulation step, and plays recordings back.
+ * Recordings contain the lasers that were spawned and the calls made on them from outside of the simulation,
+ * which is enough to simulate the same lasers again, plus the interactions and positions of the lasers to compare against.
+ * Playback re-simulates the lasers through ALaserBase, and reports where their paths diverge from the recording.
+ * Started with the Reflect.RecordLasers and Reflect.PlayLasers console commands.
+ */
+UCLASS()
+class REFLECT_API ALaserReplay : public AActor
+{
+	GENERATED_UCLASS_BODY()
+
+	// Called when the object is destroyed.
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	// The amount of steps between the recorded positions of the lasers.
+	UPROPERTY(EditAnywhere, Category = "Laser Replay", meta = (ClampMin = "1"))
+	int32 SampleInterval;
+
+	// The distance a replayed laser can be from its recorded position before it counts as diverged.
+	UPROPERTY(EditAnywhere, Category = "Laser Replay", meta = (ClampMin = "0.0"))
+	float DivergenceTolerance;
+
+	/**
+	 * Starts recording the lasers of a world, stopping any replay that is running.
+	 * @param WorldContextObject	Object used to find the world.
+	 * @param Name					The name of the recording.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Laser Replay", meta = (WorldContext = "WorldContextObject"))
+	static ALaserReplay* StartRecording(UObject* WorldContextObject, const FString& Name);
+
+	/**
+	 * Starts playing a recording back, stopping any replay that is running.
+	 * @param WorldContextObject	Object used to find the world.
+	 * @param Name					The name of the recording.
+	 * @param bQuitWhenDone			Whether the game exits once the recording has been played.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Laser Replay", meta = (WorldContext = "WorldContextObject"))
+	static ALaserReplay* StartPlayback(UObject* WorldContextObject, const FString& Name, bool bQuitWhenDone);
+
+	// Stops the replay, saving it if it is a recording, and reporting how it diverged if it is a playback.
+	UFUNCTION(BlueprintCallable, Category = "Laser Replay")
+	void Stop();
+
+	// Gets the replay that is running, if any.
+	static ALaserReplay* GetActive();
+
+	// Gets the file a recording is stored in.
+	static FString GetReplayPath(const FString& Name);
+
+	// Called when a laser is activated.
+	static void NotifyLaserActivated(ALaserBase* Laser)
+	{
+		if (ActiveReplay.IsValid())
+		{
+			ActiveReplay->OnLaserActivated(Laser);
+		}
+	}
+
+	// Called when a laser is killed or returned to the pool.
+	static void NotifyLaserDeactivated(const ALaserBase* Laser)
+	{
+		if (ActiveReplay.IsValid())
+		{
+			ActiveReplay->OnLaserDeactivated(Laser);
+		}
+	}
+
+	/**
+	 * Called when something happens to a laser.
+	 * @param Laser				The laser.
+	 * @param Type				What happened.
+	 * @param Vector			The vector argument of the call, or the location of the laser.
+	 * @param Value				The first float argument of the call.
+	 * @param Value2			The second float argument of the call.
+	 */
+	static void NotifyLaserEvent(const ALaserBase* Laser, ELaserReplayEvent::Type Type, const FVector& Vector, float Value = 0.0f, float Value2 = 0.0f)
+	{
+		if (ActiveReplay.IsValid())
+		{
+			ActiveReplay->OnLaserEvent(Laser, Type, Vector, Value, Value2);
+		}
+	}
+
+private:
+
+	// Starts following the simulation of the world.
+	void Begin(ELaserReplayMode::Type InMode);
+
+	// Stops following the simulation, saving the recording or reporting how the playback diverged.
+	void Finish();
+
+	// Called before each simulation step.
+	void OnPreStep(uint32 Step);
+
+	// Records or maps a laser that was activated.
+	void OnLaserActivated(ALaserBase* Laser);
+
+	// Forgets the number of a laser that is no longer flying, so the pool can reuse it for another one.
+	void OnLaserDeactivated(const ALaserBase* Laser);
+
+	// Records something that happened to a laser.
+	void OnLaserEvent(const ALaserBase* Laser, ELaserReplayEvent::Type Type, const FVector& Vector, float Value, float Value2);
+
+	// Replays a recorded call.
+	void ApplyEvent(const FLaserReplayEvent& Event);
+
+	// Records the positions of the lasers, or compares them with the recorded positions.
+	void SampleLasers(uint32 Step);
+
+	// Writes the recording to its file.
+	bool Save();
+
+	// Reads the recording from its file.
+	bool Load();
+
+	// Gets the step of the simulation, counted from the start of the replay.
+	uint32 GetReplayStep() const;
+
+	// The replay that is running.
+	static TWeakObjectPtr<ALaserReplay> ActiveReplay;
+
+	// Whether the replay is recording or playing.
+	ELaserReplayMode::Type Mode;
+
+	// The name of the recording.
+	FString ReplayName;
+
+	// Whether the game exits once the recording has been played.
+	bool bQuitWhenDone;
+
+	// The simulation the replay follows.
+	TWeakObjectPtr<ALaserSimulationManager> Simulation;
+
+	// Handle for the callback before each simulation step.
+	FDelegateHandle PreStepHandle;
+
+	// The simulation step the replay started at.
+	uint32 StartStep;
+
+	// The last step of the recording.
+	uint32 LastStep;
+
+	// The duration of a simulation step when the recording was made.
+	float FixedTimeStep;
+
+	// The duration of a simulation step before the playback changed it, restored when it finishes.
+	float PreviousFixedTimeStep;
+
+	// The recorded events, in order.
+	TArray<FLaserReplayEvent> Events;
+
+	// The recorded positions.
+	TArray<FLaserReplaySample> Samples;
+
+	// The paths of the laser classes used by the recording.
+	TArray<FString> ClassPaths;
+
+	// The loaded laser classes, matching ClassPaths.
+	UPROPERTY()
+	TArray<UClass*> Classes;
+
+	// The number of each laser that was activated during the replay and is still flying.
+	TMap<const ALaserBase*, int32> LaserIds;
+
+	// The next number given to a laser.
+	int32 NextLaserId;
+
+	/***************************************/
+	/* Playback                            */
+	/***************************************/
+
+	// The replayed lasers, by number.
+	TMap<int32, TWeakObjectPtr<ALaserBase>> ReplayedLasers;
+
+	// The number of the laser the replay is spawning.
+	int32 PendingSpawnId;
+
+	// Lasers that were spawned by the world instead of the replay, which are killed before the next step.
+	TArray<TWeakObjectPtr<ALaserBase>> SuppressedLasers;
+
+	// The index of the next event to replay.
+	int32 NextEventIndex;
+
+	// The recorded positions, by step and laser number.
+	TMap<uint64, FVector> RecordedPositions;
+
+	// The amount of recorded interactions, and the amount that happened again during playback.
+	int32 NumRecordedInteractions;
+	int32 NumReplayedInteractions;
+
+	// The amount of positions compared with the recording.
+	int32 NumComparedSamples;
+
+	// The furthest a replayed laser was from its recorded position.
+	float MaxDivergence;
+
+	// The first step a replayed laser was further than DivergenceTolerance from its recorded position, or MAX_uint32.
+	uint32 FirstDivergentStep;
+};
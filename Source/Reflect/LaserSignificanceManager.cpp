@@ -0,0 +1,191 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Reflect.h"
+#include "LaserSignificanceManager.h"
+#include "LaserSimulationManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Laser Significance"), STAT_LaserSignificance, STATGROUP_Reflect);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Laser Significance Full"), STAT_LaserSignificanceFull, STATGROUP_Reflect);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Laser Significance Reduced"), STAT_LaserSignificanceReduced, STATGROUP_Reflect);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Laser Significance Hidden"), STAT_LaserSignificanceHidden, STATGROUP_Reflect);
+
+
+ALaserSignificanceManager::ALaserSignificanceManager(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer)
+{
+	PrimaryActorTick.bCanEverTick = true;
+	// Lasers have been moved by the laser simulation by then
+	PrimaryActorTick.TickGroup = TG_PostPhysics;
+
+	// Default values
+	UpdateInterval = 0.1f;
+	FullDetailDistance = 3000.0f;
+	ScreenMargin = 10.0f;
+	RelevantClasses.Add(FStringClassReference(TEXT("/Game/Base/Blueprints/BP_LaserTrigger_01.BP_LaserTrigger_01_C")));
+	RelevantClasses.Add(FStringClassReference(TEXT("/Game/Base/Blueprints/BP_Checkpoint_01.BP_Checkpoint_01_C")));
+	RelevanceRadius = 1500.0f;
+
+	UpdateAccumulator = 0.0f;
+}
+
+void ALaserSignificanceManager::BeginPlay()
+{
+	Super::BeginPlay();
+
+	LevelAddedHandle = FWorldDelegates::LevelAddedToWorld.AddUObject(this, &ALaserSignificanceManager::OnLevelChanged);
+	LevelRemovedHandle = FWorldDelegates::LevelRemovedFromWorld.AddUObject(this, &ALaserSignificanceManager::OnLevelChanged);
+	RefreshRelevantActors();
+}
+
+void ALaserSignificanceManager::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	FWorldDelegates::LevelAddedToWorld.Remove(LevelAddedHandle);
+	FWorldDelegates::LevelRemovedFromWorld.Remove(LevelRemovedHandle);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ALaserSignificanceManager::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	UpdateAccumulator += DeltaSeconds;
+	if (UpdateAccumulator >= UpdateInterval)
+	{
+		UpdateAccumulator = 0.0f;
+		UpdateSignificance();
+	}
+}
+
+void ALaserSignificanceManager::RefreshRelevantActors()
+{
+	RelevantActors.Reset();
+
+	TArray<UClass*> Classes;
+	for (const FStringClassReference& ClassReference : RelevantClasses)
+	{
+		if (UClass* Class = ClassReference.TryLoadClass<AActor>())
+		{
+			Classes.Add(Class);
+		}
+	}
+
+	for (TActorIterator<AActor> It(GetWorld()); It; ++It)
+	{
+		for (UClass* Class : Classes)
+		{
+			if (It->IsA(Class))
+			{
+				RelevantActors.Add(*It);
+				break;
+			}
+		}
+	}
+}
+
+void ALaserSignificanceManager::OnLevelChanged(ULevel* Level, UWorld* World)
+{
+	// Streamed levels bring their triggers and checkpoints with them
+	if (World == GetWorld())
+	{
+		RefreshRelevantActors();
+	}
+}
+
+void ALaserSignificanceManager::UpdateSignificance()
+{
+	SCOPE_CYCLE_COUNTER(STAT_LaserSignificance);
+
+	ALaserSimulationManager* Simulation = ALaserSimulationManager::Get(this);
+	if (!Simulation)
+	{
+		return;
+	}
+
+	// Every local player counts, so split screen keeps the lasers either of them can see
+	Views.Reset();
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PlayerController = It->Get();
+		if (PlayerController && PlayerController->IsLocalController() && PlayerController->PlayerCameraManager)
+		{
+			const APlayerCameraManager* Camera = PlayerController->PlayerCameraManager;
+			FView& View = Views[Views.AddUninitialized()];
+			View.Location = Camera->GetCameraLocation();
+			View.Forward = Camera->GetCameraRotation().Vector();
+
+			// A cone around the view, as wide as its diagonal
+			const float AspectRatio = Camera->DefaultAspectRatio > 0.0f ? Camera->DefaultAspectRatio : 16.0f / 9.0f;
+			const float TanHalfFOV = FMath::Tan(FMath::DegreesToRadians(Camera->GetFOVAngle() * 0.5f));
+			const float HalfDiagonalAngle = FMath::Atan(TanHalfFOV * FMath::Sqrt(1.0f + 1.0f / FMath::Square(AspectRatio)));
+			View.CosMaxAngle = FMath::Cos(FMath::Min(HalfDiagonalAngle + FMath::DegreesToRadians(ScreenMargin), PI));
+		}
+	}
+
+	// Without a player to look at them, lasers keep all of their effects
+	if (Views.Num() == 0)
+	{
+		return;
+	}
+
+	const TArray<ALaserBase*>& Lasers = Simulation->GetLasers();
+	const float FullDetailDistanceSquared = FMath::Square(FullDetailDistance);
+
+	int32 NumLasers[ELaserSignificance::Num] = { 0 };
+	for (int32 i = 0; i < Lasers.Num(); i++)
+	{
+		ALaserBase* Laser = Lasers[i];
+		if (!Laser)
+		{
+			continue;
+		}
+
+		// Dormant lasers only have their actor moved once per frame
+		const FVector Position = Simulation->GetLaserPosition(i);
+
+		ELaserSignificance::Type Significance = ELaserSignificance::Hidden;
+		for (const FView& View : Views)
+		{
+			const FVector ToLaser = Position - View.Location;
+			const float DistanceSquared = ToLaser.SizeSquared();
+			if (FVector::DotProduct(ToLaser, View.Forward) >= View.CosMaxAngle * FMath::Sqrt(DistanceSquared))
+			{
+				Significance = DistanceSquared <= FullDetailDistanceSquared ? ELaserSignificance::Full : ELaserSignificance::Reduced;
+				if (Significance == ELaserSignificance::Full)
+				{
+					break;
+				}
+			}
+		}
+
+		if (Significance != ELaserSignificance::Full && IsNearRelevantActor(Position))
+		{
+			Significance = ELaserSignificance::Full;
+		}
+
+		Laser->SetSignificance(Significance);
+		NumLasers[Significance]++;
+	}
+
+	SET_DWORD_STAT(STAT_LaserSignificanceFull, NumLasers[ELaserSignificance::Full]);
+	SET_DWORD_STAT(STAT_LaserSignificanceReduced, NumLasers[ELaserSignificance::Reduced]);
+	SET_DWORD_STAT(STAT_LaserSignificanceHidden, NumLasers[ELaserSignificance::Hidden]);
+}
+
+bool ALaserSignificanceManager::IsNearRelevantActor(const FVector& Position) const
+{
+	const float RelevanceRadiusSquared = FMath::Square(RelevanceRadius);
+	for (const TWeakObjectPtr<AActor>& RelevantActor : RelevantActors)
+	{
+		if (RelevantActor.IsValid() && FVector::DistSquared(RelevantActor->GetActorLocation(), Position) <= RelevanceRadiusSquared)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+ALaserSignificanceManager* ALaserSignificanceManager::Get(UObject* WorldContextObject)
+{
+	static TWeakObjectPtr<ALaserSignificanceManager> CachedManager;
+	return GetOrSpawnWorldActor(WorldContextObject, CachedManager);
+}
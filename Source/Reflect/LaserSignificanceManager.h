@@ -0,0 +1,90 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "GameFramework/Actor.h"
+#include "LaserBase.h"
+#include "LaserSignificanceManager.generated.h"
+
+/**
+ * Scores every live laser by whether a player can see it, how far away it is, and whether it is near something that matters
+ * to gameplay, such as a laser trigger or a checkpoint. Insignificant lasers lose their trail particles, light and audio.
+ * Only presentation is reduced, and every laser is still moved and overlapped, so gameplay outcomes stay exact.
+ * Place one in a map to configure it.
+ */
+UCLASS()
+class REFLECT_API ALaserSignificanceManager : public AActor
+{
+	GENERATED_UCLASS_BODY()
+
+	// Called when the object is spawned.
+	virtual void BeginPlay() override;
+
+	// Called when the object is destroyed.
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	// Called every frame.
+	virtual void Tick(float DeltaSeconds) override;
+
+	// The time between updates of the significance of every laser.
+	UPROPERTY(EditAnywhere, Category = "Laser Significance", meta = (ClampMin = "0.0"))
+	float UpdateInterval;
+
+	// Lasers on screen closer than this keep all of their effects.
+	UPROPERTY(EditAnywhere, Category = "Laser Significance", meta = (ClampMin = "0.0"))
+	float FullDetailDistance;
+
+	// How far outside the view, in degrees, lasers still count as on screen. Covers camera movement between updates.
+	UPROPERTY(EditAnywhere, Category = "Laser Significance", meta = (ClampMin = "0.0", ClampMax = "90.0"))
+	float ScreenMargin;
+
+	// Lasers near actors of these classes keep all of their effects, wherever the players look.
+	UPROPERTY(EditAnywhere, Category = "Laser Significance", meta = (MetaClass = "Actor"))
+	TArray<FStringClassReference> RelevantClasses;
+
+	// How close a laser has to be to a relevant actor to keep all of its effects.
+	UPROPERTY(EditAnywhere, Category = "Laser Significance", meta = (ClampMin = "0.0"))
+	float RelevanceRadius;
+
+	// Finds the actors of the relevant classes again, after actors were spawned. Levels streamed in or out are handled already.
+	UFUNCTION(BlueprintCallable, Category = "Laser Significance")
+	void RefreshRelevantActors();
+
+	// Gets the laser significance manager of the world, spawning one if it does not exist.
+	static ALaserSignificanceManager* Get(UObject* WorldContextObject);
+
+private:
+
+	// Scores every laser and applies its significance.
+	void UpdateSignificance();
+
+	// Called when a level is added to or removed from a world.
+	void OnLevelChanged(ULevel* Level, UWorld* World);
+
+	/**
+	 * Checks whether a position is near a relevant actor.
+	 * @param Position			The position to check.
+	 */
+	bool IsNearRelevantActor(const FVector& Position) const;
+
+	// The actors of the relevant classes.
+	TArray<TWeakObjectPtr<AActor>> RelevantActors;
+
+	// The view of a local player.
+	struct FView
+	{
+		FVector Location;
+		FVector Forward;
+		float CosMaxAngle;
+	};
+
+	// The views of the local players, gathered for each update.
+	TArray<FView> Views;
+
+	// Time since the significance was last updated.
+	float UpdateAccumulator;
+
+	// Handles for the callbacks that watch levels being streamed.
+	FDelegateHandle LevelAddedHandle;
+	FDelegateHandle LevelRemovedHandle;
+};
@@ -0,0 +1,1408 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Reflect.h"
+#include "LaserSimulationManager.h"
+#include "LaserBase.h"
+#include "LaserAffector.h"
+#include "LaserAffectorComponent.h"
+#include "LaserBouncer.h"
+#include "LaserSignificanceManager.h"
+#include "LaserSteering.h"
+#include "ProfilingDebugging/ScopedTimers.h"
+#include "Async/ParallelFor.h"
+
+DECLARE_CYCLE_STAT(TEXT("Laser Simulation"), STAT_LaserSimulation, STATGROUP_Reflect);
+DECLARE_CYCLE_STAT(TEXT("Laser Steering"), STAT_LaserSteering, STATGROUP_Reflect);
+DECLARE_CYCLE_STAT(TEXT("Laser Grid Overlaps"), STAT_LaserGridOverlaps, STATGROUP_Reflect);
+DECLARE_CYCLE_STAT(TEXT("Laser Affector Dispatch"), STAT_LaserAffectorDispatch, STATGROUP_Reflect);
+DECLARE_CYCLE_STAT(TEXT("Laser Kill Checks"), STAT_LaserKillChecks, STATGROUP_Reflect);
+DECLARE_CYCLE_STAT(TEXT("Laser Movement"), STAT_LaserMovement, STATGROUP_Reflect);
+DECLARE_CYCLE_STAT(TEXT("Laser Batched Sweeps"), STAT_LaserBatchedSweeps, STATGROUP_Reflect);
+DECLARE_CYCLE_STAT(TEXT("Laser Hit Resolution"), STAT_LaserHitResolution, STATGROUP_Reflect);
+DECLARE_CYCLE_STAT(TEXT("Laser Rotations"), STAT_LaserRotations, STATGROUP_Reflect);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Live Lasers"), STAT_LiveLasers, STATGROUP_Reflect);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Laser Bounces per Second"), STAT_LaserBouncesPerSecond, STATGROUP_Reflect);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Laser Affector Calls"), STAT_LaserAffectorCalls, STATGROUP_Reflect);
+DECLARE_CYCLE_STAT(TEXT("Laser Async Sweeps"), STAT_LaserAsyncSweeps, STATGROUP_Reflect);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Laser Steps Known Clear"), STAT_LaserStepsKnownClear, STATGROUP_Reflect);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Laser Steps Swept"), STAT_LaserStepsSwept, STATGROUP_Reflect);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Dormant Lasers"), STAT_DormantLasers, STATGROUP_Reflect);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Laser Graph Predictions"), STAT_LaserGraphPredictions, STATGROUP_Reflect);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Laser Swept Predictions"), STAT_LaserSweptPredictions, STATGROUP_Reflect);
+
+namespace ELaserInterface
+{
+	enum Type : uint8
+	{
+		Bouncer = 1 << 0,
+		Affector = 1 << 1,
+	};
+}
+
+namespace
+{
+	/**
+	 * Runs a function over a range of lasers split into chunks, on worker threads if allowed.
+	 * @param Num				The amount of lasers.
+	 * @param ChunkSize			The amount of lasers in each chunk.
+	 * @param bParallel			Whether the chunks may run on worker threads.
+	 * @param Function			Called with the first index and one past the last index of each chunk.
+	 */
+	template<typename FunctionType>
+	void ParallelForChunks(int32 Num, int32 ChunkSize, bool bParallel, const FunctionType& Function)
+	{
+		const int32 NumChunks = FMath::DivideAndRoundUp(Num, ChunkSize);
+		ParallelFor(NumChunks, [&](int32 Chunk)
+		{
+			const int32 Start = Chunk * ChunkSize;
+			Function(Start, FMath::Min(Start + ChunkSize, Num));
+		}, !bParallel || NumChunks < 2);
+	}
+}
+
+TMap<TWeakObjectPtr<UClass>, uint8> ALaserSimulationManager::ClassInterfaces;
+uint32 ALaserSimulationManager::InterfaceCacheHits = 0;
+uint32 ALaserSimulationManager::InterfaceCacheMisses = 0;
+
+ALaserSimulationManager::ALaserSimulationManager(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer)
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	// Default values
+	FixedTimeStep = 1.0f / 120.0f;
+	MaxStepsPerFrame = 8;
+	TrailSampleInterval = 0.025f;
+	bParallelSimulation = true;
+	ParallelChunkSize = 256;
+	bUseAffectorGrid = true;
+	AffectorGridCellSize = 500.0f;
+	bDisableLaserOverlaps = false;
+	bAsyncSweeps = false;
+	AsyncSweepLookahead = 0.1f;
+	bDormantLasers = true;
+	DormantLookahead = 1.0f;
+	bUseReflectionGraph = true;
+	ReflectionGraphResolution = 12;
+
+	StepAccumulator = 0.0f;
+	StepCount = 0;
+	BlockerMoveCount = 0;
+	SweepsBlockerMoveCount = 0;
+	TrailSampleAccumulator = 0.0f;
+	bRecordTimings = false;
+	BouncesThisSecond = 0;
+	BounceSecondTime = 0.0f;
+	bIsSimulating = false;
+	bHasPendingRemovals = false;
+}
+
+void ALaserSimulationManager::BeginPlay()
+{
+	Super::BeginPlay();
+
+	UWorld* World = GetWorld();
+	for (TActorIterator<AActor> It(World); It; ++It)
+	{
+		OnActorSpawned(*It);
+	}
+	ActorSpawnedHandle = World->AddOnActorSpawnedHandler(FOnActorSpawned::FDelegate::CreateUObject(this, &ALaserSimulationManager::OnActorSpawned));
+
+	LevelAddedHandle = FWorldDelegates::LevelAddedToWorld.AddUObject(this, &ALaserSimulationManager::OnLevelAdded);
+	LevelRemovedHandle = FWorldDelegates::LevelRemovedFromWorld.AddUObject(this, &ALaserSimulationManager::OnLevelRemoved);
+	RebuildAffectorGrid();
+	RebuildReflectionGraph();
+
+	// Decides which lasers keep their effects
+	ALaserSignificanceManager::Get(this);
+}
+
+void ALaserSimulationManager::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	GetWorld()->RemoveOnActorSpawnedHandler(ActorSpawnedHandle);
+	for (const TPair<TWeakObjectPtr<UPrimitiveComponent>, FBox>& Blocker : BlockerBounds)
+	{
+		if (Blocker.Key.IsValid())
+		{
+			Blocker.Key->TransformUpdated.RemoveAll(this);
+		}
+	}
+	BlockerBounds.Empty();
+	for (const TWeakObjectPtr<AActor>& Actor : WatchedActors)
+	{
+		if (Actor.IsValid())
+		{
+			Actor->OnEndPlay.RemoveDynamic(this, &ALaserSimulationManager::OnBlockerEndPlay);
+		}
+	}
+	WatchedActors.Empty();
+	FWorldDelegates::LevelAddedToWorld.Remove(LevelAddedHandle);
+	FWorldDelegates::LevelRemovedFromWorld.Remove(LevelRemovedHandle);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ALaserSimulationManager::Tick(float DeltaSeconds)
+{
+	SCOPE_CYCLE_COUNTER(STAT_LaserSimulation);
+
+	Super::Tick(DeltaSeconds);
+
+	ReadAsyncSweeps();
+
+	StepAccumulator += DeltaSeconds;
+
+	int32 NumSteps = 0;
+	while (StepAccumulator >= FixedTimeStep && NumSteps < MaxStepsPerFrame)
+	{
+		StepSimulation(FixedTimeStep);
+		StepAccumulator -= FixedTimeStep;
+		NumSteps++;
+	}
+
+	// Drop the time that did not fit, instead of falling further behind every frame
+	if (NumSteps == MaxStepsPerFrame)
+	{
+		StepAccumulator = FMath::Min(StepAccumulator, FixedTimeStep);
+	}
+
+	UpdateLaserRotations();
+	MoveDormantLasers();
+
+	TrailSampleAccumulator += DeltaSeconds;
+	if (TrailSampleAccumulator >= TrailSampleInterval)
+	{
+		TrailSampleAccumulator = FMath::Fmod(TrailSampleAccumulator, TrailSampleInterval);
+
+		const int32 NumLasers = Lasers.Num();
+		for (int32 i = 0; i < NumLasers; i++)
+		{
+			Trails[i].Add(GetLaserPosition(i));
+		}
+	}
+
+	RequestAsyncSweeps();
+
+	SET_DWORD_STAT(STAT_LiveLasers, Lasers.Num());
+
+	// Bounces are counted over whole seconds, as a single frame has too few to be readable
+	BounceSecondTime += DeltaSeconds;
+	if (BounceSecondTime >= 1.0f)
+	{
+		SET_DWORD_STAT(STAT_LaserBouncesPerSecond, FMath::RoundToInt(BouncesThisSecond / BounceSecondTime));
+		BouncesThisSecond = 0;
+		BounceSecondTime = 0.0f;
+	}
+}
+
+void ALaserSimulationManager::StepSimulation(float DeltaSeconds)
+{
+	OnPreStep.Broadcast(StepCount);
+
+	bIsSimulating = true;
+
+	{
+		SCOPE_CYCLE_COUNTER(STAT_LaserSteering);
+		FSimpleScopeSecondsCounter SteeringTimer(Timings.SteeringTime, bRecordTimings);
+		TickSteering(DeltaSeconds);
+	}
+	{
+		SCOPE_CYCLE_COUNTER(STAT_LaserGridOverlaps);
+		FSimpleScopeSecondsCounter GridOverlapTimer(Timings.GridOverlapTime, bRecordTimings);
+		UpdateGridOverlaps();
+	}
+	{
+		SCOPE_CYCLE_COUNTER(STAT_LaserAffectorDispatch);
+		FSimpleScopeSecondsCounter AffectorTimer(Timings.AffectorTime, bRecordTimings);
+		TickAffectors(DeltaSeconds);
+	}
+	{
+		SCOPE_CYCLE_COUNTER(STAT_LaserKillChecks);
+		FSimpleScopeSecondsCounter KillTimer(Timings.KillTime, bRecordTimings);
+		CheckKillConditions();
+	}
+	{
+		SCOPE_CYCLE_COUNTER(STAT_LaserMovement);
+		FSimpleScopeSecondsCounter MovementTimer(Timings.MovementTime, bRecordTimings);
+		WakeDueLasers();
+		IntegratePositions(DeltaSeconds);
+		BatchSweeps(DeltaSeconds);
+		WriteBackPositions(DeltaSeconds);
+	}
+	{
+		SCOPE_CYCLE_COUNTER(STAT_LaserHitResolution);
+		FSimpleScopeSecondsCounter HitTimer(Timings.HitTime, bRecordTimings);
+		ResolveHits();
+	}
+
+	bIsSimulating = false;
+
+	if (bHasPendingRemovals)
+	{
+		RemovePendingLasers();
+	}
+
+	if (bRecordTimings)
+	{
+		Timings.Steps++;
+	}
+
+	StepCount++;
+}
+
+void ALaserSimulationManager::TickSteering(float DeltaSeconds)
+{
+	SteeringIndices.Reset();
+	SteeringDirectionsX.Reset();
+	SteeringDirectionsY.Reset();
+	SteeringDirectionsZ.Reset();
+	SteeringGoalsX.Reset();
+	SteeringGoalsY.Reset();
+	SteeringGoalsZ.Reset();
+	SteeringCos.Reset();
+	SteeringSin.Reset();
+
+	const int32 NumLasers = Lasers.Num();
+	for (int32 i = 0; i < NumLasers; i++)
+	{
+		if (Steering[i])
+		{
+			SteeringIndices.Add(i);
+			SteeringDirectionsX.Add(Directions[i].X);
+			SteeringDirectionsY.Add(Directions[i].Y);
+			SteeringDirectionsZ.Add(Directions[i].Z);
+			SteeringGoalsX.Add(GoalDirections[i].X);
+			SteeringGoalsY.Add(GoalDirections[i].Y);
+			SteeringGoalsZ.Add(GoalDirections[i].Z);
+			SteeringCos.Add(GoalStepCos[i]);
+			SteeringSin.Add(GoalStepSin[i]);
+		}
+	}
+
+	const int32 NumSteering = SteeringIndices.Num();
+	if (NumSteering == 0)
+	{
+		return;
+	}
+
+	SteeringReachedGoal.SetNumUninitialized(NumSteering, false);
+	ParallelForChunks(NumSteering, ParallelChunkSize, ShouldRunInParallel(), [this](int32 Start, int32 End)
+	{
+		FLaserSteering::TurnTowardsBatch(SteeringDirectionsX.GetData() + Start, SteeringDirectionsY.GetData() + Start, SteeringDirectionsZ.GetData() + Start,
+			SteeringGoalsX.GetData() + Start, SteeringGoalsY.GetData() + Start, SteeringGoalsZ.GetData() + Start,
+			SteeringCos.GetData() + Start, SteeringSin.GetData() + Start, SteeringReachedGoal.GetData() + Start, End - Start);
+	});
+
+	for (int32 SteeringIndex = 0; SteeringIndex < NumSteering; SteeringIndex++)
+	{
+		const int32 i = SteeringIndices[SteeringIndex];
+		Directions[i] = FVector(SteeringDirectionsX[SteeringIndex], SteeringDirectionsY[SteeringIndex], SteeringDirectionsZ[SteeringIndex]);
+		if (ALaserBase* Laser = Lasers[i])
+		{
+			Laser->ApplySteering(Directions[i], SteeringReachedGoal[SteeringIndex]);
+		}
+	}
+}
+
+void ALaserSimulationManager::UpdateGridOverlaps()
+{
+	if (AffectorGrid.Num() == 0)
+	{
+		return;
+	}
+
+	for (int32 i = 0; i < Lasers.Num(); i++)
+	{
+		// Dormant lasers wake up before they can enter a volume
+		ALaserBase* Laser = Lasers[i];
+		if (!Laser || WakeSteps[i] != 0)
+		{
+			continue;
+		}
+
+		AffectorGrid.Query(Positions[i], Radii[i], GridQueryResults);
+		if (GridQueryResults == Laser->GridAffectors)
+		{
+			continue;
+		}
+
+		// The previous volumes end up in GridQueryResults
+		Exchange(GridQueryResults, Laser->GridAffectors);
+		const TArray<int32>& Previous = GridQueryResults;
+		const TArray<int32> Current = Laser->GridAffectors;
+
+		// Both lists are sorted, so they can be merged to find the volumes that were entered or left.
+		// Affectors may kill the laser, which stops it from entering the rest.
+		int32 PreviousIndex = 0;
+		int32 CurrentIndex = 0;
+		while (Lasers[i] == Laser && (PreviousIndex < Previous.Num() || CurrentIndex < Current.Num()))
+		{
+			if (CurrentIndex == Current.Num() || (PreviousIndex < Previous.Num() && Previous[PreviousIndex] < Current[CurrentIndex]))
+			{
+				if (UPrimitiveComponent* Component = AffectorGrid.GetEntry(Previous[PreviousIndex]).Component.Get())
+				{
+					Laser->EndAffectorOverlap(Component->GetOwner(), Component);
+				}
+				PreviousIndex++;
+			}
+			else if (PreviousIndex == Previous.Num() || Current[CurrentIndex] < Previous[PreviousIndex])
+			{
+				if (UPrimitiveComponent* Component = AffectorGrid.GetEntry(Current[CurrentIndex]).Component.Get())
+				{
+					Laser->BeginAffectorOverlap(Component->GetOwner(), Component);
+				}
+				CurrentIndex++;
+			}
+			else
+			{
+				PreviousIndex++;
+				CurrentIndex++;
+			}
+		}
+	}
+}
+
+void ALaserSimulationManager::TickAffectors(float DeltaSeconds)
+{
+	for (int32 i = 0; i < Lasers.Num(); i++)
+	{
+		ALaserBase* Laser = Lasers[i];
+
+		if (Laser)
+		{
+			const int32 NumAffectorCalls = Laser->NativeAffectors.Num() + Laser->LaserAffectors.Num();
+			INC_DWORD_STAT_BY(STAT_LaserAffectorCalls, NumAffectorCalls);
+			if (bRecordTimings)
+			{
+				Timings.AffectorCalls += NumAffectorCalls;
+			}
+		}
+
+		// Affectors may kill the laser, or change which affectors it overlaps
+		for (int32 AffectorIndex = 0; Laser && AffectorIndex < Laser->NativeAffectors.Num(); AffectorIndex++)
+		{
+			Laser->NativeAffectors[AffectorIndex]->DispatchLaserTick(Laser, DeltaSeconds);
+			Laser = Lasers[i];
+		}
+
+		for (int32 AffectorIndex = 0; Laser && AffectorIndex < Laser->LaserAffectors.Num(); AffectorIndex++)
+		{
+			ILaserAffector::Execute_LaserTick(Laser->LaserAffectors[AffectorIndex], Laser, DeltaSeconds);
+			Laser = Lasers[i];
+		}
+	}
+}
+
+void ALaserSimulationManager::CheckKillConditions()
+{
+	// Only lasers that met a kill condition in UpdateLaserState are checked, and their state may have changed again since
+	Exchange(KillChecks, HandledKillChecks);
+	for (const TWeakObjectPtr<ALaserBase>& KillCheck : HandledKillChecks)
+	{
+		ALaserBase* Laser = KillCheck.Get();
+		const int32 Index = Laser ? Laser->SimulationIndex : INDEX_NONE;
+		if (Lasers.IsValidIndex(Index) && Lasers[Index] == Laser)
+		{
+			const bool bTooSlow = Speeds[Index] * Speeds[Index] < MinSpeedsSquared[Index];
+			if (bTooSlow || Bounces[Index] > MaxBounces[Index])
+			{
+				// Lasers explode when they run out of bounces, and fizzle out when they are too slow
+				Laser->Kill(!bTooSlow);
+			}
+		}
+	}
+	HandledKillChecks.Reset();
+}
+
+void ALaserSimulationManager::IntegratePositions(float DeltaSeconds)
+{
+	ParallelForChunks(Lasers.Num(), ParallelChunkSize, ShouldRunInParallel(), [this, DeltaSeconds](int32 Start, int32 End)
+	{
+		for (int32 i = Start; i < End; i++)
+		{
+			TargetPositions[i] = Positions[i] + Directions[i] * (Speeds[i] * DeltaSeconds);
+		}
+	});
+}
+
+void ALaserSimulationManager::BatchSweeps(float DeltaSeconds)
+{
+	Sweeps.Reset();
+	if (!ShouldRunInParallel())
+	{
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_LaserBatchedSweeps);
+
+	// The physics scene is only read here, so it can be read from worker threads. The sweeps are thrown away
+	// if a bouncer or blocker moves across them, spawns or is destroyed before WriteBackPositions uses them, see OnBlockerChanged.
+	const int32 NumLasers = Lasers.Num();
+	Sweeps.SetNum(NumLasers);
+	SweepsBlockerMoveCount = BlockerMoveCount;
+	ParallelForChunks(NumLasers, ParallelChunkSize, true, [this, DeltaSeconds](int32 Start, int32 End)
+	{
+		for (int32 i = Start; i < End; i++)
+		{
+			const ALaserBase* Laser = Lasers[i];
+			FLaserSweep& Sweep = Sweeps[i];
+			if (Laser && Laser->StepMode == ELaserStepMode::RayCast && WakeSteps[i] == 0 && !IsPathKnownClear(i, Speeds[i] * DeltaSeconds) && !CanHitLasers(Laser))
+			{
+				Sweep.End = Laser->GetStepEnd(Positions[i], DeltaSeconds);
+				Sweep.bBlocked = Laser->SweepStep(Positions[i], Sweep.End, Sweep.Hit);
+			}
+			else
+			{
+				// Not swept, which OnBlockerChanged sees as an empty sweep
+				Sweep.End = Positions[i];
+				Sweep.bBlocked = false;
+			}
+		}
+	});
+}
+
+bool ALaserSimulationManager::CanHitLasers(const ALaserBase* Laser)
+{
+	// Other lasers move during WriteBackPositions, so a sweep that can hit them has to wait until then
+	const UPrimitiveComponent* Collision = Laser->CollisionComp;
+	return Collision->GetCollisionResponseToChannel(Collision->GetCollisionObjectType()) == ECR_Block;
+}
+
+bool ALaserSimulationManager::ShouldRunInParallel() const
+{
+	return bParallelSimulation && FApp::ShouldUseThreadingForPerformance();
+}
+
+bool ALaserSimulationManager::IsPathKnownClear(int32 Index, float Distance) const
+{
+	// Carried step time moves the laser further than the step, so only plain steps are covered
+	return bAsyncSweeps && Distance <= ClearDistances[Index] && Directions[Index] == ClearDirections[Index] && Lasers[Index]->CarriedStepTime == 0.0f;
+}
+
+void ALaserSimulationManager::RequestAsyncSweeps()
+{
+	AsyncSweeps.Reset();
+	if (!bAsyncSweeps)
+	{
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_LaserAsyncSweeps);
+
+	UWorld* World = GetWorld();
+	FCollisionShape Shape;
+	ECollisionChannel Channel;
+	FCollisionQueryParams QueryParams;
+	FCollisionResponseParams ResponseParams;
+
+	const int32 NumLasers = Lasers.Num();
+	for (int32 i = 0; i < NumLasers; i++)
+	{
+		ALaserBase* Laser = Lasers[i];
+		if (Laser && Laser->StepMode == ELaserStepMode::RayCast && Speeds[i] > 0.0f && WakeSteps[i] == 0)
+		{
+			FLaserAsyncSweep& Sweep = AsyncSweeps[AsyncSweeps.AddUninitialized()];
+			Sweep.Laser = Laser;
+			Sweep.Direction = Directions[i];
+			Sweep.Length = Speeds[i] * AsyncSweepLookahead;
+
+			// The results are swapped in at the start of next frame, before any laser moves again
+			Laser->GetSweepSettings(Shape, Channel, QueryParams, ResponseParams);
+			Sweep.Handle = World->AsyncSweepByChannel(EAsyncTraceType::Single, Positions[i], Positions[i] + Sweep.Direction * Sweep.Length, Channel, Shape, QueryParams, ResponseParams);
+		}
+	}
+}
+
+void ALaserSimulationManager::ReadAsyncSweeps()
+{
+	if (AsyncSweeps.Num() == 0)
+	{
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_LaserAsyncSweeps);
+
+	UWorld* World = GetWorld();
+	FTraceDatum Result;
+	for (const FLaserAsyncSweep& Sweep : AsyncSweeps)
+	{
+		const ALaserBase* Laser = Sweep.Laser.Get();
+		if (Laser && Lasers.IsValidIndex(Laser->SimulationIndex) && WakeSteps[Laser->SimulationIndex] == 0 && World->QueryTraceData(Sweep.Handle, Result))
+		{
+			const int32 Index = Laser->SimulationIndex;
+			const FHitResult* Hit = Result.OutHits.FindByPredicate([](const FHitResult& OutHit) { return OutHit.bBlockingHit; });
+
+			// Stop short of the hit, so the synchronous sweep still handles the bounce
+			ClearDirections[Index] = Sweep.Direction;
+			ClearDistances[Index] = Hit ? FMath::Max(Hit->Time * Sweep.Length - 1.0f, 0.0f) : Sweep.Length;
+		}
+	}
+	AsyncSweeps.Reset();
+}
+
+void ALaserSimulationManager::WriteBackPositions(float DeltaSeconds)
+{
+	for (int32 i = 0; i < Lasers.Num(); i++)
+	{
+		// Dormant lasers are left alone until their predicted impact, see WakeDueLasers
+		ALaserBase* Laser = Lasers[i];
+		if (Laser && WakeSteps[i] == 0)
+		{
+			if (Laser->StepMode == ELaserStepMode::RayCast && IsPathKnownClear(i, Speeds[i] * DeltaSeconds))
+			{
+				// Last frame's async sweep found nothing in the way
+				Laser->SetActorLocation(TargetPositions[i], false);
+				ClearDistances[i] -= Speeds[i] * DeltaSeconds;
+				INC_DWORD_STAT(STAT_LaserStepsKnownClear);
+			}
+			else if (Laser->StepMode == ELaserStepMode::RayCast)
+			{
+				// The laser may bounce, so whatever the async sweep found no longer applies
+				ClearDistances[i] = 0.0f;
+				INC_DWORD_STAT(STAT_LaserStepsSwept);
+
+				// Collisions were already resolved by the traces, so the actor can be teleported
+				const bool bSweepIsCurrent = Sweeps.IsValidIndex(i) && SweepsBlockerMoveCount == BlockerMoveCount;
+				const FVector NewPosition = Laser->StepRayCast(Positions[i], DeltaSeconds, bSweepIsCurrent ? &Sweeps[i] : nullptr);
+				if (Lasers[i] == Laser)
+				{
+					Laser->SetActorLocation(NewPosition, false);
+				}
+			}
+			else
+			{
+				// The sweep is what detects bouncers, through ALaserBase::NotifyHit
+				Laser->SetActorLocation(TargetPositions[i], true);
+			}
+
+			// The sweep stops at blocking hits, and the hit may have killed the laser
+			if (Lasers[i] == Laser)
+			{
+				Positions[i] = Laser->GetActorLocation();
+
+				if (CanGoDormant[i])
+				{
+					TryMakeDormant(i);
+				}
+			}
+		}
+	}
+}
+
+void ALaserSimulationManager::ResolveHits()
+{
+	if (HitQueue.Num() == 0)
+	{
+		return;
+	}
+
+	// Hits on the same bouncer end up next to each other, in the order they happened
+	HitQueue.StableSort([](const TPair<int32, FLaserHit>& A, const TPair<int32, FLaserHit>& B)
+	{
+		return A.Key < B.Key;
+	});
+
+	int32 Start = 0;
+	while (Start < HitQueue.Num())
+	{
+		const int32 Group = HitQueue[Start].Key;
+		AActor* Bouncer = HitBouncers[Group];
+
+		// Earlier bouncers may have killed some of the lasers, and pooled lasers may have been reused since
+		BouncerHits.Reset();
+		int32 End = Start;
+		for (; End < HitQueue.Num() && HitQueue[End].Key == Group; End++)
+		{
+			ALaserBase* Laser = HitQueue[End].Value.Laser;
+			if (Laser->bHitQueued && Laser->IsAlive())
+			{
+				BouncerHits.Add(HitQueue[End].Value);
+			}
+			Laser->bHitQueued = false;
+		}
+
+		if (BouncerHits.Num() > 0 && !Bouncer->IsPendingKill())
+		{
+			if (ILaserBouncer* NativeBouncer = Cast<ILaserBouncer>(Bouncer))
+			{
+				NativeBouncer->OnLaserHits(BouncerHits);
+			}
+			else
+			{
+				for (const FLaserHit& Hit : BouncerHits)
+				{
+					ILaserBouncer::Execute_LaserHit(Bouncer, Hit.Laser, Hit.Normal);
+				}
+			}
+		}
+
+		Start = End;
+	}
+
+	HitQueue.Reset();
+	HitBouncers.Reset();
+	HitGroups.Reset();
+}
+
+void ALaserSimulationManager::TryMakeDormant(int32 Index)
+{
+	CanGoDormant[Index] = false;
+
+	const ALaserBase* Laser = Lasers[Index];
+	if (!bDormantLasers || Laser->StepMode != ELaserStepMode::RayCast || Steering[Index] || Speeds[Index] <= 0.0f
+		|| Laser->CarriedStepTime > 0.0f || Laser->bHitQueued || Laser->NativeAffectors.Num() > 0 || Laser->LaserAffectors.Num() > 0)
+	{
+		return;
+	}
+
+	const float Length = Speeds[Index] * DormantLookahead;
+	const FVector End = Positions[Index] + Directions[Index] * Length;
+
+	// The impact is the first blocking hit, or the first grid affector volume the laser would enter, as dormant lasers skip the grid.
+	// Hits on static geometry come from the reflection graph, unless the graph cannot tell exactly where the laser hits.
+	float HitTime = 1.0f;
+	FLaserReflectionGraph::FHit GraphHit;
+	const bool bUseGraph = ReflectionGraph.SupportsLaser(Laser);
+	const bool bGraphHit = bUseGraph && ReflectionGraph.Trace(Positions[Index], Directions[Index], Length, Radii[Index], GraphFaces[Index], GraphHit);
+	if (bUseGraph && (!bGraphHit || GraphHit.bExact))
+	{
+		INC_DWORD_STAT(STAT_LaserGraphPredictions);
+		HitTime = bGraphHit ? GraphHit.Distance / Length : 1.0f;
+		GraphFaces[Index] = bGraphHit ? GraphHit.Face : INDEX_NONE;
+	}
+	else
+	{
+		INC_DWORD_STAT(STAT_LaserSweptPredictions);
+		FHitResult Hit;
+		HitTime = Laser->SweepStep(Positions[Index], End, Hit) ? Hit.Time : 1.0f;
+		GraphFaces[Index] = INDEX_NONE;
+	}
+	const float ImpactTime = FMath::Min(HitTime, AffectorGrid.FindFirstEntry(Positions[Index], End, Radii[Index]));
+
+	// Stop short of the impact, so the step that wakes the laser sweeps into it and bounces
+	const float ClearDistance = ImpactTime * Length - 1.0f;
+	const int32 NumSteps = FMath::FloorToInt(ClearDistance / (Speeds[Index] * FixedTimeStep));
+
+	// Not worth it if the laser would wake up right away
+	if (NumSteps > 1)
+	{
+		WakeSteps[Index] = StepCount + NumSteps + 1;
+		DormantOrigins[Index] = Positions[Index];
+		DormantStartSteps[Index] = StepCount;
+		WakeUps.HeapPush(FLaserWakeUp(Lasers[Index], WakeSteps[Index]));
+	}
+}
+
+void ALaserSimulationManager::WakeDueLasers()
+{
+	while (WakeUps.Num() > 0 && WakeUps.HeapTop().Step <= StepCount)
+	{
+		FLaserWakeUp WakeUp;
+		WakeUps.HeapPop(WakeUp, false);
+
+		// Lasers that were woken up early, or unregistered, leave their wake up behind
+		ALaserBase* Laser = WakeUp.Laser.Get();
+		const int32 Index = Laser ? Laser->SimulationIndex : INDEX_NONE;
+		if (Lasers.IsValidIndex(Index) && Lasers[Index] == Laser && WakeSteps[Index] == WakeUp.Step)
+		{
+			WakeLaser(Index);
+		}
+	}
+}
+
+void ALaserSimulationManager::WakeLaser(int32 Index)
+{
+	Positions[Index] = GetLaserPosition(Index);
+	WakeSteps[Index] = 0;
+	CanGoDormant[Index] = true;
+
+	// The laser moved without using up its known clear distance
+	ClearDistances[Index] = 0.0f;
+
+	if (ALaserBase* Laser = Lasers[Index])
+	{
+		Laser->SetActorLocation(Positions[Index], false);
+	}
+}
+
+void ALaserSimulationManager::WakeLasersInBounds(const FBox& Bounds)
+{
+	if (WakeUps.Num() == 0)
+	{
+		return;
+	}
+
+	for (int32 i = 0; i < Lasers.Num(); i++)
+	{
+		if (WakeSteps[i] == 0)
+		{
+			continue;
+		}
+
+		// The laser still has to cover the rest of the line it went dormant on
+		const FVector Start = GetLaserPosition(i);
+		const FVector End = DormantOrigins[i] + Directions[i] * (Speeds[i] * FixedTimeStep * (WakeSteps[i] - DormantStartSteps[i]));
+		if (FMath::LineBoxIntersection(Bounds.ExpandBy(Radii[i]), Start, End, End - Start))
+		{
+			WakeLaser(i);
+		}
+	}
+}
+
+void ALaserSimulationManager::MoveDormantLasers()
+{
+	int32 NumDormant = 0;
+	for (int32 i = 0; i < Lasers.Num(); i++)
+	{
+		ALaserBase* Laser = Lasers[i];
+		if (Laser && WakeSteps[i] != 0)
+		{
+			NumDormant++;
+
+			// Hidden lasers are moved too, as overlap events reach gameplay volumes that are not affectors, like triggers.
+			// Overlapping an affector wakes the laser up through UpdateLaserState.
+			Positions[i] = GetLaserPosition(i);
+			Laser->SetActorLocation(Positions[i], false);
+		}
+	}
+
+	SET_DWORD_STAT(STAT_DormantLasers, NumDormant);
+}
+
+void ALaserSimulationManager::UpdateLaserRotations()
+{
+	SCOPE_CYCLE_COUNTER(STAT_LaserRotations);
+
+	for (ALaserBase* Laser : Lasers)
+	{
+		if (Laser)
+		{
+			Laser->UpdateRotation();
+		}
+	}
+}
+
+void ALaserSimulationManager::RegisterLaser(ALaserBase* Laser)
+{
+	if (!Laser || Laser->SimulationIndex != INDEX_NONE)
+	{
+		return;
+	}
+
+	Laser->SimulationIndex = Lasers.Add(Laser);
+	Laser->Simulation = this;
+
+	Positions.Add(Laser->GetActorLocation());
+	TargetPositions.Add(Laser->GetActorLocation());
+	Directions.AddUninitialized();
+	Speeds.AddUninitialized();
+	Bounces.AddUninitialized();
+	MaxBounces.AddUninitialized();
+	MinSpeedsSquared.AddUninitialized();
+	MaxSpeeds.AddUninitialized();
+	Radii.Add(Laser->CollisionComp->GetScaledSphereRadius());
+	Trails.AddDefaulted();
+	Trails.Last().Add(Laser->GetActorLocation());
+	Steering.AddUninitialized();
+	GoalDirections.AddUninitialized();
+	GoalStepCos.AddUninitialized();
+	GoalStepSin.AddUninitialized();
+	ClearDirections.Add(FVector::ZeroVector);
+	ClearDistances.Add(0.0f);
+	WakeSteps.Add(0);
+	DormantOrigins.AddUninitialized();
+	DormantStartSteps.AddUninitialized();
+	CanGoDormant.Add(true);
+	GraphFaces.Add(INDEX_NONE);
+
+	UpdateLaserState(Laser);
+	Laser->CollisionComp->bGenerateOverlapEvents = ShouldLasersGenerateOverlaps();
+}
+
+void ALaserSimulationManager::UnregisterLaser(ALaserBase* Laser)
+{
+	if (!Laser || !Lasers.IsValidIndex(Laser->SimulationIndex) || Lasers[Laser->SimulationIndex] != Laser)
+	{
+		return;
+	}
+
+	const int32 Index = Laser->SimulationIndex;
+	Laser->SimulationIndex = INDEX_NONE;
+
+	// The simulation no longer updates the laser's rotation at the end of the frame
+	Laser->UpdateRotation();
+
+	// Swapping lasers around while the simulation iterates over them would skip lasers
+	if (bIsSimulating)
+	{
+		Lasers[Index] = nullptr;
+		Speeds[Index] = 0.0f;
+		MinSpeedsSquared[Index] = 0.0f;
+		MaxBounces[Index] = MAX_int32;
+		Steering[Index] = false;
+		WakeSteps[Index] = 0;
+		bHasPendingRemovals = true;
+	}
+	else
+	{
+		RemoveLaserAt(Index);
+	}
+}
+
+void ALaserSimulationManager::UpdateLaserState(const ALaserBase* Laser)
+{
+	const int32 Index = Laser->SimulationIndex;
+	if (Lasers.IsValidIndex(Index) && Lasers[Index] == Laser)
+	{
+		// The laser's path may change, so it has to be simulated normally again
+		if (WakeSteps[Index] != 0)
+		{
+			WakeLaser(Index);
+		}
+		CanGoDormant[Index] = true;
+
+		Directions[Index] = Laser->Direction;
+		Speeds[Index] = Laser->Speed;
+		Bounces[Index] = Laser->NumberOfBounces;
+		MaxBounces[Index] = Laser->MaxBounces;
+		MinSpeedsSquared[Index] = FMath::Square(Laser->MinSpeed);
+		MaxSpeeds[Index] = Laser->MaxSpeed;
+		Steering[Index] = Laser->bHasGoal;
+
+		if (Laser->bHasGoal)
+		{
+			GoalDirections[Index] = Laser->GoalDirection;
+			FMath::SinCos(&GoalStepSin[Index], &GoalStepCos[Index], FMath::Min(Laser->GoalTurnRate * FixedTimeStep, PI));
+		}
+
+		// Kill conditions only change with the laser's state, so they are not checked every step
+		if (Speeds[Index] * Speeds[Index] < MinSpeedsSquared[Index] || Bounces[Index] > MaxBounces[Index])
+		{
+			KillChecks.Add(Lasers[Index]);
+		}
+	}
+}
+
+void ALaserSimulationManager::TeleportLaser(const ALaserBase* Laser)
+{
+	const int32 Index = Laser->SimulationIndex;
+	if (Lasers.IsValidIndex(Index) && Lasers[Index] == Laser)
+	{
+		// A dormant laser's path no longer starts where it went dormant
+		Positions[Index] = Laser->GetActorLocation();
+		WakeSteps[Index] = 0;
+		CanGoDormant[Index] = true;
+		ClearDistances[Index] = 0.0f;
+	}
+}
+
+int32 ALaserSimulationManager::GetNumLasers() const
+{
+	return Lasers.Num();
+}
+
+uint32 ALaserSimulationManager::GetStepCount() const
+{
+	return StepCount;
+}
+
+bool ALaserSimulationManager::IsSimulating() const
+{
+	return bIsSimulating;
+}
+
+const TArray<ALaserBase*>& ALaserSimulationManager::GetLasers() const
+{
+	return Lasers;
+}
+
+const TArray<FVector>& ALaserSimulationManager::GetPositions() const
+{
+	return Positions;
+}
+
+FVector ALaserSimulationManager::GetLaserPosition(int32 Index) const
+{
+	if (WakeSteps[Index] == 0)
+	{
+		return Positions[Index];
+	}
+
+	// Dormant lasers move in a straight line, so their position follows from the steps finished since they went dormant
+	const int32 NumSteps = FMath::Max<int32>(StepCount - 1 - DormantStartSteps[Index], 0);
+	return DormantOrigins[Index] + Directions[Index] * (Speeds[Index] * FixedTimeStep * NumSteps);
+}
+
+const TArray<FLaserTrail>& ALaserSimulationManager::GetTrails() const
+{
+	return Trails;
+}
+
+FLaserPathCache& ALaserSimulationManager::GetPathCache()
+{
+	return PathCache;
+}
+
+void ALaserSimulationManager::SetRecordTimings(bool bRecord)
+{
+	if (bRecord && !bRecordTimings)
+	{
+		Timings = FLaserSimulationTimings();
+	}
+	bRecordTimings = bRecord;
+}
+
+bool ALaserSimulationManager::IsRecordingTimings() const
+{
+	return bRecordTimings;
+}
+
+const FLaserSimulationTimings& ALaserSimulationManager::GetTimings() const
+{
+	return Timings;
+}
+
+void ALaserSimulationManager::RecordBounce()
+{
+	BouncesThisSecond++;
+}
+
+void ALaserSimulationManager::QueueHit(ALaserBase* Laser, AActor* Bouncer, UPrimitiveComponent* Component, const FVector& Location, const FVector& Normal)
+{
+	FLaserHit Hit;
+	Hit.Laser = Laser;
+	Hit.Component = Component;
+	Hit.Location = Location;
+	Hit.Normal = Normal;
+
+	// Bouncers are numbered in the order they were first hit, so the order they are resolved in does not depend on their addresses
+	int32* Group = HitGroups.Find(Bouncer);
+	if (!Group)
+	{
+		Group = &HitGroups.Add(Bouncer, HitBouncers.Add(Bouncer));
+	}
+	HitQueue.Emplace(*Group, Hit);
+}
+
+void ALaserSimulationManager::RecordHit(double Seconds)
+{
+	if (bRecordTimings)
+	{
+		Timings.Hits++;
+		Timings.HitTime += Seconds;
+	}
+}
+
+const FLaserAffectorGrid& ALaserSimulationManager::GetAffectorGrid() const
+{
+	return AffectorGrid;
+}
+
+const FLaserReflectionGraph& ALaserSimulationManager::GetReflectionGraph() const
+{
+	return ReflectionGraph;
+}
+
+void ALaserSimulationManager::RebuildReflectionGraph()
+{
+	if (bUseReflectionGraph)
+	{
+		ReflectionGraph.Build(GetWorld(), ReflectionGraphResolution);
+	}
+	else
+	{
+		ReflectionGraph.Reset();
+	}
+
+	// Lasers start their next prediction from scratch
+	for (int32 i = 0; i < GraphFaces.Num(); i++)
+	{
+		GraphFaces[i] = INDEX_NONE;
+	}
+	PathCache.Invalidate();
+}
+
+void ALaserSimulationManager::RebuildAffectorGrid()
+{
+	// Leave the volumes of the old grid, so the lasers enter the volumes of the new grid from scratch
+	for (int32 i = 0; i < Lasers.Num(); i++)
+	{
+		ALaserBase* Laser = Lasers[i];
+		if (Laser)
+		{
+			const TArray<int32> Previous = Laser->GridAffectors;
+			Laser->GridAffectors.Reset();
+			for (int32 Index : Previous)
+			{
+				UPrimitiveComponent* Component = AffectorGrid.GetEntry(Index).Component.Get();
+				if (Component && Lasers[i] == Laser)
+				{
+					Laser->EndAffectorOverlap(Component->GetOwner(), Component);
+				}
+			}
+		}
+	}
+
+	if (bUseAffectorGrid)
+	{
+		AffectorGrid.Build(GetWorld(), AffectorGridCellSize);
+	}
+	else
+	{
+		AffectorGrid.Reset();
+	}
+
+	// Overlaps that began through physics events would never end once their volume is in the grid
+	for (int32 i = 0; i < Lasers.Num(); i++)
+	{
+		ALaserBase* Laser = Lasers[i];
+		if (!Laser)
+		{
+			continue;
+		}
+
+		const TArray<ULaserAffectorComponent*> NativeAffectors = Laser->NativeAffectors;
+		for (ULaserAffectorComponent* NativeAffector : NativeAffectors)
+		{
+			if (Lasers[i] == Laser && AffectorGrid.Contains(NativeAffector))
+			{
+				Laser->EndAffectorOverlap(NativeAffector->GetOwner(), NativeAffector);
+			}
+		}
+
+		const TArray<AActor*> LaserAffectors = Laser->LaserAffectors;
+		for (AActor* LaserAffector : LaserAffectors)
+		{
+			TInlineComponentArray<UPrimitiveComponent*> Components(LaserAffector);
+			for (UPrimitiveComponent* Component : Components)
+			{
+				if (Lasers[i] == Laser && AffectorGrid.Contains(Component) && Laser->LaserAffectors.Contains(LaserAffector))
+				{
+					Laser->EndAffectorOverlap(LaserAffector, Component);
+				}
+			}
+		}
+
+		if (Lasers[i] == Laser)
+		{
+			Laser->CollisionComp->bGenerateOverlapEvents = ShouldLasersGenerateOverlaps();
+		}
+	}
+}
+
+bool ALaserSimulationManager::ShouldLasersGenerateOverlaps() const
+{
+	// Overlap events are only needed for affector volumes that are not in the grid
+	const bool bGridHasEveryAffector = bUseAffectorGrid && !AffectorGrid.HasMovableAffectors();
+	return !(bDisableLaserOverlaps && bGridHasEveryAffector);
+}
+
+void ALaserSimulationManager::OnLevelAdded(ULevel* Level, UWorld* World)
+{
+	if (World == GetWorld())
+	{
+		RebuildAffectorGrid();
+		RebuildReflectionGraph();
+	}
+}
+
+void ALaserSimulationManager::OnLevelRemoved(ULevel* Level, UWorld* World)
+{
+	if (World == GetWorld())
+	{
+		RebuildAffectorGrid();
+		RebuildReflectionGraph();
+	}
+}
+
+void ALaserSimulationManager::OnActorSpawned(AActor* Actor)
+{
+	ReflectionGraph.AddDynamicBlockers(Actor);
+
+	if (!Actor || Actor->IsA<ALaserBase>())
+	{
+		return;
+	}
+
+	// The grid is built in BeginPlay, so only actors spawned after that are added to it
+	if (bUseAffectorGrid && HasActorBegunPlay())
+	{
+		const bool bGeneratedOverlaps = ShouldLasersGenerateOverlaps();
+		AffectorGrid.AddActor(Actor);
+
+		// A movable affector needs overlap events to reach the lasers
+		if (ShouldLasersGenerateOverlaps() != bGeneratedOverlaps)
+		{
+			for (ALaserBase* Laser : Lasers)
+			{
+				if (Laser)
+				{
+					Laser->CollisionComp->bGenerateOverlapEvents = ShouldLasersGenerateOverlaps();
+				}
+			}
+		}
+	}
+
+	// Bouncers and blockers can appear in, move into, or leave the path of dormant lasers, and of the sweeps done ahead of time
+	const bool bIsBouncer = IsLaserBouncer(Actor);
+	bool bHasBlockers = false;
+	TInlineComponentArray<UPrimitiveComponent*> Components(Actor);
+	for (UPrimitiveComponent* Component : Components)
+	{
+		if (!bIsBouncer && !BlocksLasers(Component))
+		{
+			continue;
+		}
+
+		bHasBlockers = true;
+		if (HasActorBegunPlay())
+		{
+			OnBlockerChanged(Component->Bounds.GetBox());
+		}
+		if (Component->Mobility == EComponentMobility::Movable)
+		{
+			Component->TransformUpdated.AddUObject(this, &ALaserSimulationManager::OnBlockerMoved);
+			BlockerBounds.Add(Component, Component->Bounds.GetBox());
+		}
+	}
+
+	if (bHasBlockers)
+	{
+		Actor->OnEndPlay.AddDynamic(this, &ALaserSimulationManager::OnBlockerEndPlay);
+		WatchedActors.Add(Actor);
+	}
+}
+
+void ALaserSimulationManager::OnBlockerMoved(USceneComponent* Component, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+	UPrimitiveComponent* Primitive = Cast<UPrimitiveComponent>(Component);
+	FBox* Bounds = BlockerBounds.Find(Primitive);
+	if (!Bounds)
+	{
+		return;
+	}
+
+	// Lasers are affected where the blocker was, and where it is now
+	const FBox NewBounds = Primitive->Bounds.GetBox();
+	OnBlockerChanged(*Bounds);
+	OnBlockerChanged(NewBounds);
+	*Bounds = NewBounds;
+}
+
+void ALaserSimulationManager::OnBlockerEndPlay(AActor* Actor, EEndPlayReason::Type EndPlayReason)
+{
+	// The whole world is going away
+	if (EndPlayReason != EEndPlayReason::Destroyed && EndPlayReason != EEndPlayReason::RemovedFromWorld)
+	{
+		return;
+	}
+
+	const bool bIsBouncer = IsLaserBouncer(Actor);
+	TInlineComponentArray<UPrimitiveComponent*> Components(Actor);
+	for (UPrimitiveComponent* Component : Components)
+	{
+		if (BlockerBounds.Remove(Component) > 0)
+		{
+			Component->TransformUpdated.RemoveAll(this);
+			OnBlockerChanged(Component->Bounds.GetBox());
+		}
+		else if (bIsBouncer || BlocksLasers(Component))
+		{
+			OnBlockerChanged(Component->Bounds.GetBox());
+		}
+	}
+}
+
+void ALaserSimulationManager::OnBlockerChanged(const FBox& Bounds)
+{
+	// Dormant lasers would pass through a blocker that appeared in their line, or stop at one that left it
+	WakeLasersInBounds(Bounds);
+
+	// Predicted paths that pass through the box may end elsewhere now
+	PathCache.InvalidateInBounds(Bounds.ExpandBy(GetDefault<ALaserBase>()->CollisionComp->GetScaledSphereRadius()));
+
+	const bool bSweepsAreCurrent = Sweeps.Num() == Lasers.Num() && SweepsBlockerMoveCount == BlockerMoveCount;
+	bool bSweepsChanged = false;
+	for (int32 i = 0; i < Lasers.Num(); i++)
+	{
+		if (WakeSteps[i] != 0)
+		{
+			continue;
+		}
+
+		// The path a laser's async sweep found clear
+		const FBox LaserBounds = Bounds.ExpandBy(Radii[i]);
+		if (ClearDistances[i] > 0.0f)
+		{
+			const FVector ClearEnd = Positions[i] + ClearDirections[i] * ClearDistances[i];
+			if (FMath::LineBoxIntersection(LaserBounds, Positions[i], ClearEnd, ClearEnd - Positions[i]))
+			{
+				ClearDistances[i] = 0.0f;
+			}
+		}
+
+		// The sweep batched for this step, which may have missed the blocker, or hit where it was
+		if (bSweepsAreCurrent && !bSweepsChanged && FMath::LineBoxIntersection(LaserBounds, Positions[i], Sweeps[i].End, Sweeps[i].End - Positions[i]))
+		{
+			bSweepsChanged = true;
+		}
+	}
+
+	if (bSweepsChanged)
+	{
+		BlockerMoveCount++;
+	}
+}
+
+bool ALaserSimulationManager::BlocksLasers(const UPrimitiveComponent* Component)
+{
+	// Same check as the sweeps of a default laser, see ALaserBase::GetSweepSettings
+	const USphereComponent* LaserCollision = GetDefault<ALaserBase>()->CollisionComp;
+	const ECollisionEnabled::Type CollisionEnabled = Component->GetCollisionEnabled();
+	return (CollisionEnabled == ECollisionEnabled::QueryOnly || CollisionEnabled == ECollisionEnabled::QueryAndPhysics)
+		&& Component->GetCollisionResponseToChannel(LaserCollision->GetCollisionObjectType()) == ECR_Block
+		&& LaserCollision->GetCollisionResponseToChannel(Component->GetCollisionObjectType()) == ECR_Block;
+}
+
+ALaserSimulationManager* ALaserSimulationManager::Get(UObject* WorldContextObject)
+{
+	static TWeakObjectPtr<ALaserSimulationManager> CachedManager;
+	return GetOrSpawnWorldActor(WorldContextObject, CachedManager);
+}
+
+ALaserSimulationManager* ALaserSimulationManager::Find(UObject* WorldContextObject)
+{
+	static TWeakObjectPtr<ALaserSimulationManager> CachedManager;
+	return FindWorldActor(WorldContextObject, CachedManager);
+}
+
+void ALaserSimulationManager::RemoveLaserAt(int32 Index)
+{
+	Lasers.RemoveAtSwap(Index, 1, false);
+	Positions.RemoveAtSwap(Index, 1, false);
+	TargetPositions.RemoveAtSwap(Index, 1, false);
+	Directions.RemoveAtSwap(Index, 1, false);
+	Speeds.RemoveAtSwap(Index, 1, false);
+	Bounces.RemoveAtSwap(Index, 1, false);
+	MaxBounces.RemoveAtSwap(Index, 1, false);
+	MinSpeedsSquared.RemoveAtSwap(Index, 1, false);
+	MaxSpeeds.RemoveAtSwap(Index, 1, false);
+	Radii.RemoveAtSwap(Index, 1, false);
+	Trails.RemoveAtSwap(Index, 1, false);
+	Steering.RemoveAtSwap(Index, 1, false);
+	GoalDirections.RemoveAtSwap(Index, 1, false);
+	GoalStepCos.RemoveAtSwap(Index, 1, false);
+	GoalStepSin.RemoveAtSwap(Index, 1, false);
+	ClearDirections.RemoveAtSwap(Index, 1, false);
+	ClearDistances.RemoveAtSwap(Index, 1, false);
+	WakeSteps.RemoveAtSwap(Index, 1, false);
+	DormantOrigins.RemoveAtSwap(Index, 1, false);
+	DormantStartSteps.RemoveAtSwap(Index, 1, false);
+	CanGoDormant.RemoveAtSwap(Index, 1, false);
+	GraphFaces.RemoveAtSwap(Index, 1, false);
+
+	// The last laser was moved into the removed slot
+	if (Lasers.IsValidIndex(Index) && Lasers[Index])
+	{
+		Lasers[Index]->SimulationIndex = Index;
+	}
+}
+
+void ALaserSimulationManager::RemovePendingLasers()
+{
+	for (int32 i = Lasers.Num() - 1; i >= 0; i--)
+	{
+		if (!Lasers[i])
+		{
+			RemoveLaserAt(i);
+		}
+	}
+	bHasPendingRemovals = false;
+}
+
+bool ALaserSimulationManager::IsLaserBouncer(const AActor* Actor)
+{
+	return (GetLaserInterfaces(Actor) & ELaserInterface::Bouncer) != 0;
+}
+
+bool ALaserSimulationManager::IsLaserAffector(const AActor* Actor)
+{
+	return (GetLaserInterfaces(Actor) & ELaserInterface::Affector) != 0;
+}
+
+float ALaserSimulationManager::GetInterfaceCacheHitRate()
+{
+	const uint32 NumChecks = InterfaceCacheHits + InterfaceCacheMisses;
+	return NumChecks > 0 ? (float)InterfaceCacheHits / NumChecks : 0.0f;
+}
+
+uint8 ALaserSimulationManager::GetLaserInterfaces(const AActor* Actor)
+{
+	if (!Actor)
+	{
+		return 0;
+	}
+
+	UClass* Class = Actor->GetClass();
+	if (const uint8* Interfaces = ClassInterfaces.Find(Class))
+	{
+		InterfaceCacheHits++;
+		return *Interfaces;
+	}
+
+	InterfaceCacheMisses++;
+
+	uint8 Interfaces = 0;
+	if (Class->ImplementsInterface(ULaserBouncer::StaticClass()))
+	{
+		Interfaces |= ELaserInterface::Bouncer;
+	}
+	if (Class->ImplementsInterface(ULaserAffector::StaticClass()))
+	{
+		Interfaces |= ELaserInterface::Affector;
+	}
+
+	ClassInterfaces.Add(Class, Interfaces);
+	return Interfaces;
+}
+
+/***************************************/
+/* Console command                     */
+/***************************************/
+
+namespace
+{
+	void SetAsyncLaserSweeps(const TArray<FString>& Args, UWorld* World)
+	{
+		ALaserSimulationManager* Manager = World ? ALaserSimulationManager::Get(World) : nullptr;
+		if (!Manager)
+		{
+			return;
+		}
+
+		Manager->bAsyncSweeps = Args.Num() > 0 ? Args[0].ToBool() : !Manager->bAsyncSweeps;
+		UE_LOG(LogReflect, Log, TEXT("Laser async sweeps %s"), Manager->bAsyncSweeps ? TEXT("enabled") : TEXT("disabled"));
+	}
+
+	FAutoConsoleCommandWithWorldAndArgs AsyncLaserSweepsCommand(
+		TEXT("Reflect.AsyncLaserSweeps"),
+		TEXT("Switches the lasers between async and synchronous sweeps, to compare them. Arguments: [0|1], toggles if omitted"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&SetAsyncLaserSweeps));
+
+	void SetLaserReflectionGraph(const TArray<FString>& Args, UWorld* World)
+	{
+		ALaserSimulationManager* Manager = World ? ALaserSimulationManager::Get(World) : nullptr;
+		if (!Manager)
+		{
+			return;
+		}
+
+		Manager->bUseReflectionGraph = Args.Num() > 0 ? Args[0].ToBool() : !Manager->bUseReflectionGraph;
+		Manager->RebuildReflectionGraph();
+		UE_LOG(LogReflect, Log, TEXT("Laser reflection graph %s, %d blockers"), Manager->bUseReflectionGraph ? TEXT("enabled") : TEXT("disabled"), Manager->GetReflectionGraph().Num());
+	}
+
+	FAutoConsoleCommandWithWorldAndArgs LaserReflectionGraphCommand(
+		TEXT("Reflect.LaserReflectionGraph"),
+		TEXT("Switches laser hit predictions between the reflection graph and sweeps, to compare them. Arguments: [0|1], toggles if omitted"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&SetLaserReflectionGraph));
+}
@@ -0,0 +1,622 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "GameFramework/Actor.h"
+#include "LaserPath.h"
+#include "LaserAffectorGrid.h"
+#include "LaserReflectionGraph.h"
+#include "LaserBase.h"
+#include "LaserBouncer.h"
+#include "LaserSimulationManager.generated.h"
+
+// Called before each simulation step, with the number of the step.
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnLaserSimulationStep, uint32);
+
+/**
+ * Time spent in each phase of the laser simulation, recorded while benchmarking.
+ */
+struct FLaserSimulationTimings
+{
+	// The amount of simulation steps that ran.
+	int32 Steps;
+
+	// Seconds spent turning lasers towards their goals.
+	double SteeringTime;
+
+	// Seconds spent finding the affector grid volumes lasers entered and left.
+	double GridOverlapTime;
+
+	// Seconds spent ticking affectors.
+	double AffectorTime;
+
+	// Seconds spent checking kill conditions.
+	double KillTime;
+
+	// Seconds spent moving lasers, including their collisions.
+	double MovementTime;
+
+	// Seconds spent handling hits, and resolving the bouncer hits queued during movement. Only the former is part of MovementTime.
+	double HitTime;
+
+	// The amount of hits lasers handled.
+	int32 Hits;
+
+	// The amount of times an affector ticked a laser.
+	int32 AffectorCalls;
+
+	FLaserSimulationTimings()
+	{
+		FMemory::Memzero(*this);
+	}
+};
+
+/**
+ * The most recent positions of a laser, sampled at a fixed interval, for drawing its trail.
+ */
+struct FLaserTrail
+{
+	enum { MaxPoints = 8 };
+
+	FLaserTrail()
+		: Head(0)
+		, Num(0)
+	{
+	}
+
+	// Adds a position, replacing the oldest one if the trail is full.
+	void Add(const FVector& Position)
+	{
+		Head = (Head + 1) % MaxPoints;
+		Points[Head] = Position;
+		Num = FMath::Min(Num + 1, (int32)MaxPoints);
+	}
+
+	// Gets a position, where 0 is the most recent one.
+	const FVector& GetPoint(int32 Age) const
+	{
+		return Points[(Head - Age + MaxPoints) % MaxPoints];
+	}
+
+	// The positions, as a ring buffer.
+	FVector Points[MaxPoints];
+
+	// The index of the most recent position.
+	int32 Head;
+
+	// The amount of positions in the trail.
+	int32 Num;
+};
+
+/**
+ * A dormant laser's predicted impact, ordered by the step the laser has to wake up on.
+ */
+struct FLaserWakeUp
+{
+	FLaserWakeUp()
+		: Step(0)
+	{
+	}
+
+	FLaserWakeUp(ALaserBase* InLaser, uint32 InStep)
+		: Laser(InLaser)
+		, Step(InStep)
+	{
+	}
+
+	bool operator<(const FLaserWakeUp& Other) const
+	{
+		return Step < Other.Step;
+	}
+
+	// The dormant laser.
+	TWeakObjectPtr<ALaserBase> Laser;
+
+	// The step the laser wakes up on.
+	uint32 Step;
+};
+
+/**
+ * An async sweep ahead of a laser, waiting for its result.
+ */
+struct FLaserAsyncSweep
+{
+	// The laser the sweep is for.
+	TWeakObjectPtr<ALaserBase> Laser;
+
+	// Handle to the result of the sweep.
+	FTraceHandle Handle;
+
+	// The direction the laser was moving in when the sweep was requested.
+	FVector Direction;
+
+	// The length of the sweep.
+	float Length;
+};
+
+/**
+ * Simulates the movement of every live laser in the world in a single tick.
+ * The movement state of the lasers is stored as a structure of arrays, so the
+ * kill checks and integration run as tight loops instead of one actor tick per laser.
+ */
+UCLASS()
+class REFLECT_API ALaserSimulationManager : public AActor
+{
+	GENERATED_UCLASS_BODY()
+
+	// Called every frame.
+	virtual void Tick(float DeltaSeconds) override;
+
+	// The duration of a simulation step. Frames run as many steps as fit in their duration.
+	UPROPERTY(EditAnywhere, Category = "Laser Simulation", meta = (ClampMin = "0.001"))
+	float FixedTimeStep;
+
+	// The maximum amount of steps in a single frame. Time beyond this is dropped to keep long frames from getting longer.
+	UPROPERTY(EditAnywhere, Category = "Laser Simulation", meta = (ClampMin = "1"))
+	int32 MaxStepsPerFrame;
+
+	// Whether the per laser passes of the simulation are spread over worker threads.
+	UPROPERTY(EditAnywhere, Category = "Laser Simulation|Threading")
+	bool bParallelSimulation;
+
+	// The amount of lasers each worker thread task handles at once.
+	UPROPERTY(EditAnywhere, Category = "Laser Simulation|Threading", meta = (ClampMin = "1", EditCondition = "bParallelSimulation"))
+	int32 ParallelChunkSize;
+
+	// Whether ray cast lasers sweep ahead of themselves with async traces, and skip their synchronous sweeps while the path is known to be clear.
+	// Faster, but the results are a frame old, so objects spawned into a laser's path can be missed.
+	UPROPERTY(EditAnywhere, Category = "Laser Simulation|Collision")
+	bool bAsyncSweeps;
+
+	// How far ahead lasers sweep with async traces, in seconds of movement. Should cover at least a frame.
+	UPROPERTY(EditAnywhere, Category = "Laser Simulation|Collision", meta = (ClampMin = "0.0", EditCondition = "bAsyncSweeps"))
+	float AsyncSweepLookahead;
+
+	// Whether ray cast lasers that move in a straight line without affectors go dormant until just before their next predicted hit.
+	// Dormant lasers are moved along their line once per frame, instead of being swept every step.
+	// They wake up early when a bouncer or a blocker is spawned into, moves across or is removed from their line.
+	UPROPERTY(EditAnywhere, Category = "Laser Simulation|Collision")
+	bool bDormantLasers;
+
+	// How far ahead lasers look for their next hit before going dormant, in seconds of movement.
+	UPROPERTY(EditAnywhere, Category = "Laser Simulation|Collision", meta = (ClampMin = "0.0", EditCondition = "bDormantLasers"))
+	float DormantLookahead;
+
+	// Whether lasers predict their next hit on static geometry through a graph built at level load, instead of a sweep.
+	// Hits the graph cannot answer exactly, like the edges of boxes and shapes other than boxes, are still swept.
+	UPROPERTY(EditAnywhere, Category = "Laser Simulation|Collision")
+	bool bUseReflectionGraph;
+
+	// The amount of directions the reflection graph tells apart along half a circle. Higher values test fewer boxes per hit, but use more memory.
+	// Lowered for maps with many boxes, to bound that memory.
+	UPROPERTY(EditAnywhere, Category = "Laser Simulation|Collision", meta = (ClampMin = "2", ClampMax = "64", EditCondition = "bUseReflectionGraph"))
+	int32 ReflectionGraphResolution;
+
+	// The time between the positions recorded for laser trails.
+	UPROPERTY(EditAnywhere, Category = "Laser Simulation", meta = (ClampMin = "0.001"))
+	float TrailSampleInterval;
+
+	// Whether lasers find static affector volumes through a grid built at level load, instead of overlap events.
+	UPROPERTY(EditAnywhere, Category = "Laser Simulation|Affectors")
+	bool bUseAffectorGrid;
+
+	// The size of the cells of the affector grid.
+	UPROPERTY(EditAnywhere, Category = "Laser Simulation|Affectors", meta = (ClampMin = "10.0", EditCondition = "bUseAffectorGrid"))
+	float AffectorGridCellSize;
+
+	// Whether lasers stop generating overlap events when every affector is in the grid. Only safe if nothing else relies on laser overlaps.
+	UPROPERTY(EditAnywhere, Category = "Laser Simulation|Affectors", meta = (EditCondition = "bUseAffectorGrid"))
+	bool bDisableLaserOverlaps;
+
+	// Called when the object is spawned.
+	virtual void BeginPlay() override;
+
+	// Called when the object is destroyed.
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/**
+	 * Adds a laser to the simulation.
+	 * @param Laser				The laser to simulate.
+	 */
+	void RegisterLaser(ALaserBase* Laser);
+
+	/**
+	 * Removes a laser from the simulation.
+	 * @param Laser				The laser to stop simulating.
+	 */
+	void UnregisterLaser(ALaserBase* Laser);
+
+	/**
+	 * Copies the velocity, bounces and speed limits of a laser into the simulation.
+	 * @param Laser				The laser that changed.
+	 */
+	void UpdateLaserState(const ALaserBase* Laser);
+
+	/**
+	 * Moves the simulated position of a laser to where its actor was teleported to.
+	 * @param Laser				The laser that was teleported.
+	 */
+	void TeleportLaser(const ALaserBase* Laser);
+
+	// Gets the amount of lasers being simulated.
+	UFUNCTION(BlueprintCallable, Category = "Laser")
+	int32 GetNumLasers() const;
+
+	// Gets the amount of steps simulated since the simulation started.
+	uint32 GetStepCount() const;
+
+	// Whether a simulation step is running. Changes made to lasers during a step are caused by the simulation.
+	bool IsSimulating() const;
+
+	// Called before each simulation step.
+	FOnLaserSimulationStep OnPreStep;
+
+	// Gets the simulated lasers. Entries can be null while the simulation is running.
+	const TArray<ALaserBase*>& GetLasers() const;
+
+	// Gets the position of each simulated laser. Dormant lasers are only moved once per frame.
+	const TArray<FVector>& GetPositions() const;
+
+	/**
+	 * Gets the current position of a simulated laser, even if it is dormant.
+	 * @param Index				The index of the laser.
+	 */
+	FVector GetLaserPosition(int32 Index) const;
+
+	// Gets the recent positions of each simulated laser.
+	const TArray<FLaserTrail>& GetTrails() const;
+
+	/**
+	 * Starts or stops recording the time spent in each phase of the simulation.
+	 * @param bRecord			Whether to record. Starting a recording clears the previous one.
+	 */
+	void SetRecordTimings(bool bRecord);
+
+	// Whether the simulation is recording timings.
+	bool IsRecordingTimings() const;
+
+	// Gets the timings recorded since the recording started.
+	const FLaserSimulationTimings& GetTimings() const;
+
+	/**
+	 * Records a hit handled by a laser, if timings are being recorded.
+	 * @param Seconds			The time it took to handle the hit.
+	 */
+	void RecordHit(double Seconds);
+
+	/**
+	 * Queues a laser's hit on a bouncer, to be resolved once every laser has moved.
+	 * @param Laser				The laser that hit the bouncer.
+	 * @param Bouncer			The bouncer that was hit.
+	 * @param Component			The component of the bouncer that was hit.
+	 * @param Location			Where the laser hit the bouncer.
+	 * @param Normal			The normal vector of the impact.
+	 */
+	void QueueHit(ALaserBase* Laser, AActor* Bouncer, UPrimitiveComponent* Component, const FVector& Location, const FVector& Normal);
+
+	// Counts a bounce for the bounces per second stat.
+	void RecordBounce();
+
+	// Gets the predicted laser paths, which are invalidated whenever a bouncer moves.
+	FLaserPathCache& GetPathCache();
+
+	// Gets the index of static affector volumes.
+	const FLaserAffectorGrid& GetAffectorGrid() const;
+
+	// Rebuilds the index of static affector volumes, for levels that were streamed in or out.
+	UFUNCTION(BlueprintCallable, Category = "Laser")
+	void RebuildAffectorGrid();
+
+	// Gets the graph of static laser blockers.
+	const FLaserReflectionGraph& GetReflectionGraph() const;
+
+	// Rebuilds the graph of static laser blockers, for levels that were streamed in or out.
+	UFUNCTION(BlueprintCallable, Category = "Laser")
+	void RebuildReflectionGraph();
+
+	// Gets the laser simulation of the world, spawning one if it does not exist.
+	static ALaserSimulationManager* Get(UObject* WorldContextObject);
+
+	// Gets the laser simulation of the world, or null if it does not exist.
+	static ALaserSimulationManager* Find(UObject* WorldContextObject);
+
+	/**
+	 * Checks whether an actor implements ILaserBouncer. The result is cached per class.
+	 * @param Actor				The actor to check. Can be null.
+	 */
+	static bool IsLaserBouncer(const AActor* Actor);
+
+	/**
+	 * Checks whether an actor implements ILaserAffector. The result is cached per class.
+	 * @param Actor				The actor to check. Can be null.
+	 */
+	static bool IsLaserAffector(const AActor* Actor);
+
+	// Gets the fraction of interface checks that were answered by the cache.
+	UFUNCTION(BlueprintCallable, Category = "Laser")
+	static float GetInterfaceCacheHitRate();
+
+private:
+
+	// Gets the laser interfaces an actor implements, as ELaserInterface flags.
+	static uint8 GetLaserInterfaces(const AActor* Actor);
+
+	// The laser interfaces implemented by each class that has been checked.
+	static TMap<TWeakObjectPtr<UClass>, uint8> ClassInterfaces;
+
+	// The amount of interface checks that were answered by the cache, and that were not.
+	static uint32 InterfaceCacheHits;
+	static uint32 InterfaceCacheMisses;
+
+	// Whether lasers need overlap events to find their affectors.
+	bool ShouldLasersGenerateOverlaps() const;
+
+	// Called when a level is added to the world.
+	void OnLevelAdded(ULevel* Level, UWorld* World);
+
+	// Called when a level is removed from the world.
+	void OnLevelRemoved(ULevel* Level, UWorld* World);
+
+	// Starts watching an actor for movement and destruction, if it is a bouncer or blocks lasers.
+	void OnActorSpawned(AActor* Actor);
+
+	// Called when a movable component of a bouncer, or a movable component that blocks lasers, moves.
+	void OnBlockerMoved(USceneComponent* Component, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport);
+
+	// Called when a bouncer, or an actor with components that block lasers, is destroyed or streamed out.
+	UFUNCTION()
+	void OnBlockerEndPlay(AActor* Actor, EEndPlayReason::Type EndPlayReason);
+
+	/**
+	 * Wakes up the dormant lasers, and throws away the clear paths, sweeps and predictions, that pass through a box a blocker appeared in or left.
+	 * @param Bounds			The bounds of the blocker.
+	 */
+	void OnBlockerChanged(const FBox& Bounds);
+
+	// Whether a component blocks the sweeps of a default laser.
+	static bool BlocksLasers(const UPrimitiveComponent* Component);
+
+	// Runs a single fixed step of the simulation.
+	void StepSimulation(float DeltaSeconds);
+
+	// Turns the steering lasers towards their goal directions.
+	void TickSteering(float DeltaSeconds);
+
+	// Finds the grid affector volumes each laser enters and leaves.
+	void UpdateGridOverlaps();
+
+	// Lets the affectors of every laser act on it.
+	void TickAffectors(float DeltaSeconds);
+
+	// Kills the lasers that became too slow, or bounced too many times, since the last check.
+	void CheckKillConditions();
+
+	// Finds where every laser moves to along its velocity.
+	void IntegratePositions(float DeltaSeconds);
+
+	// Traces the first sweep of every ray cast laser on worker threads, for WriteBackPositions to use.
+	void BatchSweeps(float DeltaSeconds);
+
+	// Whether the sweeps of a laser can hit other lasers, which keeps them from being batched.
+	static bool CanHitLasers(const ALaserBase* Laser);
+
+	// Whether the per laser passes should run on worker threads.
+	bool ShouldRunInParallel() const;
+
+	/**
+	 * Checks whether a laser can move without sweeping, because an async sweep found its path clear.
+	 * @param Index				The index of the laser.
+	 * @param Distance			The distance the laser moves.
+	 */
+	bool IsPathKnownClear(int32 Index, float Distance) const;
+
+	// Requests async sweeps ahead of every ray cast laser, to be read next frame.
+	void RequestAsyncSweeps();
+
+	// Reads the async sweeps requested last frame into the known clear distance of each laser.
+	void ReadAsyncSweeps();
+
+	// Moves the laser actors to their simulated positions, resolving their collisions on the way.
+	void WriteBackPositions(float DeltaSeconds);
+
+	// Lets the bouncers hit this step bounce the lasers that hit them, one batch per bouncer.
+	void ResolveHits();
+
+	/**
+	 * Makes a laser dormant if nothing but its next impact can change its path, sweeping ahead once to find that impact.
+	 * @param Index				The index of the laser.
+	 */
+	void TryMakeDormant(int32 Index);
+
+	// Wakes up the dormant lasers that are about to reach their predicted impact.
+	void WakeDueLasers();
+
+	/**
+	 * Moves a dormant laser's actor to its simulated position, and simulates it normally again.
+	 * @param Index				The index of the laser.
+	 */
+	void WakeLaser(int32 Index);
+
+	/**
+	 * Wakes up the dormant lasers whose path to their predicted impact passes through a box.
+	 * @param Bounds			The box, like the bounds of a blocker that moved.
+	 */
+	void WakeLasersInBounds(const FBox& Bounds);
+
+	// Moves the actors of the dormant lasers to their simulated positions.
+	void MoveDormantLasers();
+
+	// Rotates the lasers that changed direction this frame, once instead of on every change.
+	void UpdateLaserRotations();
+
+	// Removes the laser at an index by swapping the last laser into its place.
+	void RemoveLaserAt(int32 Index);
+
+	// Removes the lasers that were unregistered while the simulation was running.
+	void RemovePendingLasers();
+
+	/***************************************/
+	/* Laser state                         */
+	/***************************************/
+
+	// The simulated lasers. Entries are null while waiting to be removed.
+	UPROPERTY()
+	TArray<ALaserBase*> Lasers;
+
+	// The position of each laser.
+	TArray<FVector> Positions;
+
+	// The position each laser moves to this frame, if it does not collide with anything.
+	TArray<FVector> TargetPositions;
+
+	// The normalized direction of each laser.
+	TArray<FVector> Directions;
+
+	// The speed of each laser.
+	TArray<float> Speeds;
+
+	// The amount of times each laser has bounced.
+	TArray<int32> Bounces;
+
+	// The maximum amount of bounces of each laser.
+	TArray<int32> MaxBounces;
+
+	// The squared minimum speed of each laser.
+	TArray<float> MinSpeedsSquared;
+
+	// The maximum speed of each laser.
+	TArray<float> MaxSpeeds;
+
+	// The collision radius of each laser.
+	TArray<float> Radii;
+
+	// The recent positions of each laser.
+	TArray<FLaserTrail> Trails;
+
+	// The direction each laser's path is known to be clear in, found by an async sweep.
+	TArray<FVector> ClearDirections;
+
+	// How far each laser's path is known to be clear.
+	TArray<float> ClearDistances;
+
+	// The step each dormant laser wakes up on. 0 if it is simulated normally.
+	TArray<uint32> WakeSteps;
+
+	// Where each dormant laser was when it went dormant.
+	TArray<FVector> DormantOrigins;
+
+	// The step each dormant laser went dormant on.
+	TArray<uint32> DormantStartSteps;
+
+	// Whether each laser's state changed since it last tried to go dormant.
+	TArray<bool> CanGoDormant;
+
+	// The reflection graph face each laser was last predicted to hit, which it leaves after bouncing.
+	TArray<int32> GraphFaces;
+
+	// The predicted impacts of the dormant lasers, as a heap. Lasers that wake up early leave theirs behind.
+	TArray<FLaserWakeUp> WakeUps;
+
+	// Whether each laser is turning towards a goal direction.
+	TArray<bool> Steering;
+
+	// The goal direction of each laser.
+	TArray<FVector> GoalDirections;
+
+	// Cosine of the angle each laser turns towards its goal in a step.
+	TArray<float> GoalStepCos;
+
+	// Sine of the angle each laser turns towards its goal in a step.
+	TArray<float> GoalStepSin;
+
+	// Indices of the steering lasers, and their steering state gathered for FLaserSteering::TurnTowardsBatch, one array per component.
+	TArray<int32> SteeringIndices;
+	TArray<float> SteeringDirectionsX;
+	TArray<float> SteeringDirectionsY;
+	TArray<float> SteeringDirectionsZ;
+	TArray<float> SteeringGoalsX;
+	TArray<float> SteeringGoalsY;
+	TArray<float> SteeringGoalsZ;
+	TArray<float> SteeringCos;
+	TArray<float> SteeringSin;
+	TArray<bool> SteeringReachedGoal;
+
+	// Lasers that met a kill condition when their state changed, to be killed on the next kill check.
+	TArray<TWeakObjectPtr<ALaserBase>> KillChecks;
+
+	// The kill checks being handled, as killing lasers can queue more.
+	TArray<TWeakObjectPtr<ALaserBase>> HandledKillChecks;
+
+	// The first sweep of each laser, traced by BatchSweeps. Empty if the sweeps were not batched.
+	TArray<FLaserSweep> Sweeps;
+
+	// The amount of times a bouncer or blocker has moved, spawned or been destroyed, and that amount when the sweeps were batched.
+	// The batched sweeps are only used while the two match.
+	uint32 BlockerMoveCount;
+	uint32 SweepsBlockerMoveCount;
+
+	// The bouncer hits of this step, and the index in HitBouncers of the bouncer each of them hit.
+	TArray<TPair<int32, FLaserHit>> HitQueue;
+
+	// The bouncers hit this step, in the order they were first hit, and the index of each of them.
+	TArray<AActor*> HitBouncers;
+	TMap<AActor*, int32> HitGroups;
+
+	// The hits on a single bouncer, passed to ILaserBouncer::OnLaserHits.
+	TArray<FLaserHit> BouncerHits;
+
+	// The async sweeps requested last frame.
+	TArray<FLaserAsyncSweep> AsyncSweeps;
+
+	// Time that has passed, but has not been simulated yet.
+	float StepAccumulator;
+
+	// The amount of steps simulated since the simulation started.
+	uint32 StepCount;
+
+	// Time since the positions of the laser trails were last recorded.
+	float TrailSampleAccumulator;
+
+	// Predicted laser paths.
+	FLaserPathCache PathCache;
+
+	// Static affector volumes.
+	FLaserAffectorGrid AffectorGrid;
+
+	// Static laser blockers.
+	FLaserReflectionGraph ReflectionGraph;
+
+	// The grid affector volumes a laser overlaps, gathered for the laser being updated.
+	TArray<int32> GridQueryResults;
+
+	// Handles for the callbacks that watch levels being streamed.
+	FDelegateHandle LevelAddedHandle;
+	FDelegateHandle LevelRemovedHandle;
+
+	// Handle for the callback that watches newly spawned actors.
+	FDelegateHandle ActorSpawnedHandle;
+
+	// The bouncers and actors with components that block lasers, watched until they are destroyed.
+	TArray<TWeakObjectPtr<AActor>> WatchedActors;
+
+	// The movable components of those actors, watched as they move, and their bounds when they last moved.
+	TMap<TWeakObjectPtr<UPrimitiveComponent>, FBox> BlockerBounds;
+
+	// Time spent in each phase of the simulation.
+	FLaserSimulationTimings Timings;
+
+	// Whether Timings is being recorded.
+	bool bRecordTimings;
+
+	// The amount of bounces since the bounces per second stat was last updated.
+	int32 BouncesThisSecond;
+
+	// The time since the bounces per second stat was last updated.
+	float BounceSecondTime;
+
+	// Whether the simulation is running, which delays removing lasers.
+	bool bIsSimulating;
+
+	// Whether lasers were unregistered while the simulation was running.
+	bool bHasPendingRemovals;
+};
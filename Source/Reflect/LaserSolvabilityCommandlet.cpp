@@ -0,0 +1,479 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Reflect.h"
+#include "LaserSolvabilityCommandlet.h"
+#include "LaserBase.h"
+#include "LaserPath.h"
+#include "LaserReflectionGraph.h"
+#include "LaserSimulationManager.h"
+#include "Async/ParallelFor.h"
+
+namespace
+{
+	// The fewest bounces found so far that get a laser to a trigger.
+	struct FLaserSolution
+	{
+		// The amount of bounces before the laser reaches the trigger, or INDEX_NONE if no laser has.
+		int32 Bounces;
+
+		// The path that reaches the trigger, as an index into the origins times the directions.
+		int32 Path;
+
+		FLaserSolution()
+			: Bounces(INDEX_NONE)
+			, Path(INDEX_NONE)
+		{
+		}
+
+		// Whether another solution takes fewer bounces, or as many from an earlier path so the results do not depend on threading.
+		bool IsWorseThan(const FLaserSolution& Other) const
+		{
+			return Other.Bounces != INDEX_NONE && (Bounces == INDEX_NONE || Other.Bounces < Bounces || (Other.Bounces == Bounces && Other.Path < Path));
+		}
+	};
+
+	// Directions spread evenly over a sphere, along a spiral.
+	FVector GetSpiralDirection(int32 Index, int32 NumDirections)
+	{
+		static const float GoldenAngle = PI * (3.0f - FMath::Sqrt(5.0f));
+		const float Z = 1.0f - 2.0f * (Index + 0.5f) / NumDirections;
+		const float Radius = FMath::Sqrt(FMath::Max(1.0f - Z * Z, 0.0f));
+		const float Angle = GoldenAngle * Index;
+		return FVector(Radius * FMath::Cos(Angle), Radius * FMath::Sin(Angle), Z);
+	}
+
+	// Gets the components of a trigger that lasers overlap.
+	void GetTriggerComponents(const AActor* Trigger, const ALaserBase* Laser, TArray<UPrimitiveComponent*>& OutComponents)
+	{
+		const UPrimitiveComponent* LaserCollision = Laser->CollisionComp;
+
+		TInlineComponentArray<UPrimitiveComponent*> Components(Trigger);
+		for (UPrimitiveComponent* Component : Components)
+		{
+			const ECollisionEnabled::Type CollisionEnabled = Component->GetCollisionEnabled();
+			if (Component->bGenerateOverlapEvents && (CollisionEnabled == ECollisionEnabled::QueryOnly || CollisionEnabled == ECollisionEnabled::QueryAndPhysics)
+				&& Component->GetCollisionResponseToChannel(LaserCollision->GetCollisionObjectType()) != ECR_Ignore
+				&& LaserCollision->GetCollisionResponseToChannel(Component->GetCollisionObjectType()) != ECR_Ignore)
+			{
+				OutComponents.Add(Component);
+			}
+		}
+	}
+
+	// Gets the bounds of the components of a trigger that lasers overlap, or of the whole trigger if it has none.
+	FBox GetTriggerBounds(const AActor* Trigger, const TArray<UPrimitiveComponent*>& Components)
+	{
+		FBox Bounds(ForceInit);
+		for (const UPrimitiveComponent* Component : Components)
+		{
+			Bounds += Component->Bounds.GetBox();
+		}
+		return Bounds.IsValid ? Bounds : Trigger->GetComponentsBoundingBox();
+	}
+
+	/**
+	 * Checks whether a laser moving along a segment overlaps a trigger.
+	 * @param Bounds			The bounds of the trigger, which are tested first.
+	 * @param Components		The components of the trigger that lasers overlap. Only the bounds are tested if there are none.
+	 * @param Start				Where the segment starts.
+	 * @param End				Where the segment ends.
+	 * @param Radius			The radius of the laser.
+	 */
+	bool IsSegmentInTrigger(const FBox& Bounds, const TArray<UPrimitiveComponent*>& Components, const FVector& Start, const FVector& End, float Radius)
+	{
+		FVector HitLocation;
+		FVector HitNormal;
+		float HitTime;
+		if (!FMath::LineExtentBoxIntersection(Bounds, Start, End, FVector(Radius), HitLocation, HitNormal, HitTime))
+		{
+			return false;
+		}
+		if (Components.Num() == 0)
+		{
+			return true;
+		}
+
+		// The bounds of rotated and round shapes reach well past them
+		const FCollisionShape Shape = FCollisionShape::MakeSphere(Radius);
+		for (UPrimitiveComponent* Component : Components)
+		{
+			FHitResult Hit;
+			if (Component->SweepComponent(Hit, Start, End, FQuat::Identity, Shape))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+ULaserSolvabilityCommandlet::ULaserSolvabilityCommandlet(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer)
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+	HelpDescription = TEXT("Checks that lasers can reach the triggers of puzzle maps.");
+	HelpUsage = TEXT("UE4Editor-Cmd Reflect.uproject -run=LaserSolvability [-Map=TestMap+TutorialMap] [-Directions=20000] [-MaxDistance=20000] [-Jobs=4]");
+
+	// Default values
+	LaserClass = FStringClassReference(TEXT("/Game/Base/Blueprints/BP_Laser_01.BP_Laser_01_C"));
+	TriggerClass = FStringClassReference(TEXT("/Game/Base/Blueprints/BP_LaserTrigger_01.BP_LaserTrigger_01_C"));
+	OriginClasses.Add(FStringClassReference(TEXT("/Game/Base/Blueprints/BP_FirstPersonStatic_01.BP_FirstPersonStatic_01_C")));
+	OriginClasses.Add(FStringClassReference(TEXT("/Game/Base/Blueprints/BP_Checkpoint_01.BP_Checkpoint_01_C")));
+	NumDirections = 20000;
+	MaxDistance = 20000.0f;
+	OriginHeight = 64.0f;
+	GraphResolution = 12;
+}
+
+int32 ULaserSolvabilityCommandlet::Main(const FString& Params)
+{
+	FString ClassName;
+	if (FParse::Value(*Params, TEXT("LaserClass="), ClassName))
+	{
+		LaserClass = FStringClassReference(ClassName);
+	}
+	if (FParse::Value(*Params, TEXT("TriggerClass="), ClassName))
+	{
+		TriggerClass = FStringClassReference(ClassName);
+	}
+	FParse::Value(*Params, TEXT("Directions="), NumDirections);
+	FParse::Value(*Params, TEXT("MaxDistance="), MaxDistance);
+	FParse::Value(*Params, TEXT("GraphResolution="), GraphResolution);
+	NumDirections = FMath::Max(NumDirections, 1);
+
+	TArray<FString> Maps;
+	FindMaps(Params, Maps);
+	if (Maps.Num() == 0)
+	{
+		UE_LOG(LogReflect, Error, TEXT("Laser solvability found no maps to check."));
+		return 1;
+	}
+
+	// Loading maps does not scale over threads, so each map gets its own process
+	int32 Jobs = FMath::Max(FPlatformMisc::NumberOfCores() / 2, 1);
+	FParse::Value(*Params, TEXT("Jobs="), Jobs);
+	if (!FParse::Param(*Params, TEXT("Child")) && Maps.Num() > 1 && Jobs > 1)
+	{
+		return RunChildren(Maps, Params, Jobs);
+	}
+
+	int32 Result = 0;
+	for (const FString& Map : Maps)
+	{
+		if (CheckMap(Map) != 0)
+		{
+			Result = 1;
+		}
+	}
+	return Result;
+}
+
+void ULaserSolvabilityCommandlet::FindMaps(const FString& Params, TArray<FString>& OutMaps) const
+{
+	FString MapList;
+	if (FParse::Value(*Params, TEXT("Map="), MapList))
+	{
+		TArray<FString> Names;
+		MapList.ParseIntoArray(Names, TEXT("+"));
+		for (const FString& Name : Names)
+		{
+			FString LongName;
+			if (FPackageName::IsValidLongPackageName(Name))
+			{
+				OutMaps.Add(Name);
+			}
+			else if (FPackageName::SearchForPackageOnDisk(Name, &LongName))
+			{
+				OutMaps.Add(LongName);
+			}
+			else
+			{
+				UE_LOG(LogReflect, Error, TEXT("Laser solvability could not find map %s."), *Name);
+			}
+		}
+		return;
+	}
+
+	TArray<FString> Files;
+	const FString Wildcard = FString(TEXT("*")) + FPackageName::GetMapPackageExtension();
+	IFileManager::Get().FindFilesRecursive(Files, *FPaths::GameContentDir(), *Wildcard, true, false);
+	for (const FString& File : Files)
+	{
+		FString LongName;
+		if (FPackageName::TryConvertFilenameToLongPackageName(File, LongName))
+		{
+			OutMaps.Add(LongName);
+		}
+	}
+	OutMaps.Sort();
+}
+
+int32 ULaserSolvabilityCommandlet::RunChildren(const TArray<FString>& Maps, const FString& Params, int32 Jobs) const
+{
+	const FString Executable = FPaths::Combine(FPlatformProcess::BaseDir(), FPlatformProcess::ExecutableName(false));
+	const FString ProjectPath = FPaths::ConvertRelativePathToFull(FPaths::GetProjectFilePath());
+
+	// Children get their own map and run alone, so only the options for checking a map are passed on
+	TArray<FString> Tokens;
+	Params.ParseIntoArrayWS(Tokens);
+	FString ChildParams;
+	for (const FString& Token : Tokens)
+	{
+		const FString Option = Token.StartsWith(TEXT("-")) ? Token.Mid(1) : Token;
+		if (!Option.StartsWith(TEXT("Map=")) && !Option.StartsWith(TEXT("Jobs=")))
+		{
+			ChildParams += TEXT(" ") + Token;
+		}
+	}
+
+	TArray<TPair<FString, FProcHandle>> Running;
+	int32 NextMap = 0;
+	int32 Result = 0;
+
+	while (NextMap < Maps.Num() || Running.Num() > 0)
+	{
+		while (Running.Num() < Jobs && NextMap < Maps.Num())
+		{
+			const FString& Map = Maps[NextMap++];
+			IFileManager::Get().Delete(*GetReportPath(Map), false, false, true);
+			const FString Args = FString::Printf(TEXT("\"%s\" -run=LaserSolvability -Map=%s -Child -unattended -nullrhi -nopause -nosplash %s"), *ProjectPath, *Map, *ChildParams);
+			FProcHandle Handle = FPlatformProcess::CreateProc(*Executable, *Args, true, false, false, nullptr, 0, nullptr, nullptr);
+			if (!Handle.IsValid())
+			{
+				UE_LOG(LogReflect, Error, TEXT("Laser solvability could not start a process for %s."), *Map);
+				Result = 1;
+				continue;
+			}
+			Running.Emplace(Map, Handle);
+		}
+
+		FPlatformProcess::Sleep(0.1f);
+
+		for (int32 i = Running.Num() - 1; i >= 0; i--)
+		{
+			FProcHandle& Handle = Running[i].Value;
+			if (FPlatformProcess::IsProcRunning(Handle))
+			{
+				continue;
+			}
+
+			int32 ReturnCode = 1;
+			FPlatformProcess::GetProcReturnCode(Handle, &ReturnCode);
+			FPlatformProcess::CloseProc(Handle);
+
+			FString Report;
+			if (FFileHelper::LoadFileToString(Report, *GetReportPath(Running[i].Key)))
+			{
+				UE_LOG(LogReflect, Display, TEXT("%s"), *Report);
+			}
+			else
+			{
+				UE_LOG(LogReflect, Error, TEXT("Laser solvability got no report for %s."), *Running[i].Key);
+				ReturnCode = 1;
+			}
+
+			if (ReturnCode != 0)
+			{
+				Result = 1;
+			}
+			Running.RemoveAtSwap(i);
+		}
+	}
+
+	return Result;
+}
+
+int32 ULaserSolvabilityCommandlet::CheckMap(const FString& MapName) const
+{
+	UE_LOG(LogReflect, Display, TEXT("Laser solvability loading %s"), *MapName);
+
+	UPackage* Package = LoadPackage(nullptr, *MapName, LOAD_None);
+	UWorld* World = Package ? UWorld::FindWorldInPackage(Package) : nullptr;
+	if (!World)
+	{
+		UE_LOG(LogReflect, Error, TEXT("Laser solvability could not load %s."), *MapName);
+		return INDEX_NONE;
+	}
+
+	// Only collision is needed, for the sweeps
+	World->WorldType = EWorldType::Editor;
+	World->AddToRoot();
+	if (!World->bIsWorldInitialized)
+	{
+		UWorld::InitializationValues InitValues;
+		InitValues.RequiresHitProxies(false);
+		InitValues.ShouldSimulatePhysics(false);
+		InitValues.EnableTraceCollision(true);
+		InitValues.CreateNavigation(false);
+		InitValues.CreateAISystem(false);
+		InitValues.AllowAudioPlayback(false);
+		InitValues.CreatePhysicsScene(true);
+		World->InitWorld(InitValues);
+	}
+
+	// Parts of a puzzle can be in streamed levels
+	for (ULevelStreaming* StreamingLevel : World->StreamingLevels)
+	{
+		if (StreamingLevel)
+		{
+			StreamingLevel->bShouldBeLoaded = true;
+			StreamingLevel->bShouldBeVisible = true;
+		}
+	}
+	World->FlushLevelStreaming();
+	World->UpdateWorldComponents(true, false);
+
+	UClass* LoadedLaserClass = LaserClass.TryLoadClass<ALaserBase>();
+	if (!LoadedLaserClass)
+	{
+		UE_LOG(LogReflect, Warning, TEXT("Laser solvability could not load %s, using ALaserBase."), *LaserClass.ToString());
+		LoadedLaserClass = ALaserBase::StaticClass();
+	}
+	const ALaserBase* Laser = LoadedLaserClass->GetDefaultObject<ALaserBase>();
+	const float Radius = GetDefault<ALaserBase>()->CollisionComp->GetUnscaledSphereRadius();
+
+	TArray<UClass*> LoadedOriginClasses;
+	LoadedOriginClasses.Add(APlayerStart::StaticClass());
+	for (const FStringClassReference& OriginClass : OriginClasses)
+	{
+		if (UClass* LoadedOriginClass = OriginClass.TryLoadClass<AActor>())
+		{
+			LoadedOriginClasses.Add(LoadedOriginClass);
+		}
+	}
+	UClass* LoadedTriggerClass = TriggerClass.TryLoadClass<AActor>();
+
+	TArray<AActor*> Triggers;
+	TArray<TArray<UPrimitiveComponent*>> TriggerComponents;
+	TArray<FBox> TriggerBounds;
+	TSet<const AActor*> Bouncers;
+	TArray<AActor*> Origins;
+	TArray<FVector> OriginLocations;
+
+	for (TActorIterator<AActor> It(World); It; ++It)
+	{
+		AActor* Actor = *It;
+
+		// The interface cache is not safe to use from the worker threads
+		if (ALaserSimulationManager::IsLaserBouncer(Actor))
+		{
+			Bouncers.Add(Actor);
+		}
+
+		if (LoadedTriggerClass && Actor->IsA(LoadedTriggerClass))
+		{
+			Triggers.Add(Actor);
+			TArray<UPrimitiveComponent*>& Components = TriggerComponents[TriggerComponents.AddDefaulted()];
+			GetTriggerComponents(Actor, Laser, Components);
+			TriggerBounds.Add(GetTriggerBounds(Actor, Components));
+		}
+
+		for (UClass* LoadedOriginClass : LoadedOriginClasses)
+		{
+			if (Actor->IsA(LoadedOriginClass))
+			{
+				const APawn* Pawn = Cast<APawn>(Actor);
+				Origins.Add(Actor);
+				OriginLocations.Add(Pawn ? Pawn->GetPawnViewLocation() : Actor->GetActorLocation() + FVector(0.0f, 0.0f, OriginHeight));
+				break;
+			}
+		}
+	}
+
+	// Sweeps against static geometry are looked up in the graph
+	FLaserReflectionGraph Graph;
+	Graph.Build(World, GraphResolution);
+
+	const int32 NumPaths = Origins.Num() * NumDirections;
+	const int32 ChunkSize = 64;
+	const int32 NumChunks = FMath::DivideAndRoundUp(NumPaths, ChunkSize);
+	TArray<FLaserSolution> Solutions;
+	Solutions.SetNum(Triggers.Num());
+	FCriticalSection SolutionsLock;
+	const double StartTime = FPlatformTime::Seconds();
+
+	ParallelFor(NumChunks, [&](int32 Chunk)
+	{
+		TArray<FLaserSolution> ChunkSolutions;
+		ChunkSolutions.SetNum(Triggers.Num());
+		TArray<FLaserPathSegment> Segments;
+
+		const int32 EndPath = FMath::Min((Chunk + 1) * ChunkSize, NumPaths);
+		for (int32 Path = Chunk * ChunkSize; Path < EndPath; Path++)
+		{
+			const FVector Direction = GetSpiralDirection(Path % NumDirections, NumDirections);
+			Segments.Reset();
+			ULaserPathFunctions::TraceLaserPath(World, OriginLocations[Path / NumDirections], Direction, Laser->MaxBounces, Laser->BounceClampAngle, MaxDistance, Segments, &Graph, &Bouncers);
+
+			// The laser has bounced once for every segment before the one that reaches the trigger
+			for (int32 Bounces = 0; Bounces < Segments.Num(); Bounces++)
+			{
+				const FLaserPathSegment& Segment = Segments[Bounces];
+				for (int32 i = 0; i < Triggers.Num(); i++)
+				{
+					if (ChunkSolutions[i].Bounces != INDEX_NONE && ChunkSolutions[i].Bounces <= Bounces)
+					{
+						continue;
+					}
+
+					if (Segment.HitActor == Triggers[i] || IsSegmentInTrigger(TriggerBounds[i], TriggerComponents[i], Segment.Start, Segment.End, Radius))
+					{
+						ChunkSolutions[i].Bounces = Bounces;
+						ChunkSolutions[i].Path = Path;
+					}
+				}
+			}
+		}
+
+		FScopeLock Lock(&SolutionsLock);
+		for (int32 i = 0; i < Triggers.Num(); i++)
+		{
+			if (Solutions[i].IsWorseThan(ChunkSolutions[i]))
+			{
+				Solutions[i] = ChunkSolutions[i];
+			}
+		}
+	});
+
+	TArray<FString> Lines;
+	int32 NumUnreachable = 0;
+	for (int32 i = 0; i < Triggers.Num(); i++)
+	{
+		const FLaserSolution& Solution = Solutions[i];
+		if (Solution.Bounces == INDEX_NONE)
+		{
+			NumUnreachable++;
+			Lines.Add(FString::Printf(TEXT("  %s: UNREACHABLE"), *Triggers[i]->GetName()));
+		}
+		else
+		{
+			const int32 Origin = Solution.Path / NumDirections;
+			const FVector Direction = GetSpiralDirection(Solution.Path % NumDirections, NumDirections);
+			Lines.Add(FString::Printf(TEXT("  %s: %d bounces, from %s at %s towards %s"), *Triggers[i]->GetName(), Solution.Bounces,
+				*Origins[Origin]->GetName(), *OriginLocations[Origin].ToString(), *Direction.ToString()));
+		}
+	}
+
+	Lines.Insert(FString::Printf(TEXT("Laser solvability of %s: %d of %d triggers reachable, %d paths from %d origins in %.1f s, %d graph blockers"),
+		*MapName, Triggers.Num() - NumUnreachable, Triggers.Num(), NumPaths, Origins.Num(), FPlatformTime::Seconds() - StartTime, Graph.Num()), 0);
+
+	const FString Report = FString::Join(Lines, LINE_TERMINATOR);
+	UE_LOG(LogReflect, Display, TEXT("%s"), *Report);
+	if (!FFileHelper::SaveStringToFile(Report + LINE_TERMINATOR, *GetReportPath(MapName)))
+	{
+		UE_LOG(LogReflect, Error, TEXT("Laser solvability could not write %s."), *GetReportPath(MapName));
+	}
+
+	World->CleanupWorld();
+	World->RemoveFromRoot();
+	CollectGarbage(RF_NoFlags);
+
+	return NumUnreachable;
+}
+
+FString ULaserSolvabilityCommandlet::GetReportPath(const FString& MapName)
+{
+	return FPaths::GameSavedDir() / TEXT("LaserSolvability") / FPackageName::GetShortName(MapName) + TEXT(".txt");
+}
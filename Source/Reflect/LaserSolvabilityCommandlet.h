@@ -0,0 +1,72 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "Commandlets/Commandlet.h"
+#include "LaserSolvabilityCommandlet.generated.h"
+
+/**
+ * Checks that lasers can reach the triggers of puzzle maps, without playing them.
+ * Loads each map headless and fires laser paths from every player position in many directions, with the bounce model of the laser class.
+ * Reports which triggers are reachable and the fewest bounces that reach them, in the log and in Saved/LaserSolvability.
+ * Maps are checked in child processes at the same time, and the directions of a map are spread over every core, e.g.
+ * UE4Editor-Cmd Reflect.uproject -run=LaserSolvability -Map=TestMap+TutorialMap -Directions=20000 -Jobs=4
+ * Checks every map in the content folder if no map is given. Returns 1 if a trigger can not be reached.
+ */
+UCLASS()
+class REFLECT_API ULaserSolvabilityCommandlet : public UCommandlet
+{
+	GENERATED_UCLASS_BODY()
+
+	// Runs the commandlet.
+	virtual int32 Main(const FString& Params) override;
+
+	// The laser whose bounce model is used. Set with -LaserClass=.
+	FStringClassReference LaserClass;
+
+	// The actors lasers have to reach. Set with -TriggerClass=.
+	FStringClassReference TriggerClass;
+
+	// The actors lasers are fired from, besides player starts.
+	TArray<FStringClassReference> OriginClasses;
+
+	// The amount of directions fired from each position. Set with -Directions=.
+	int32 NumDirections;
+
+	// The maximum length of a laser path. Set with -MaxDistance=.
+	float MaxDistance;
+
+	// How far above origins that are not pawns lasers are fired from, like the eyes of a player standing there.
+	float OriginHeight;
+
+	// The amount of directions the reflection graph tells apart along half a circle. Set with -GraphResolution=.
+	int32 GraphResolution;
+
+private:
+
+	/**
+	 * Finds the maps to check.
+	 * @param Params			The parameters of the commandlet, which can list maps with -Map=.
+	 * @param OutMaps			The long package names of the maps.
+	 */
+	void FindMaps(const FString& Params, TArray<FString>& OutMaps) const;
+
+	/**
+	 * Checks maps in child processes.
+	 * @param Maps				The long package names of the maps.
+	 * @param Params			The parameters of the commandlet, passed on to the children without the map list and job count.
+	 * @param Jobs				The amount of children running at the same time.
+	 * @return					The return code of the commandlet.
+	 */
+	int32 RunChildren(const TArray<FString>& Maps, const FString& Params, int32 Jobs) const;
+
+	/**
+	 * Checks a single map in this process, and writes its report.
+	 * @param MapName			The long package name of the map.
+	 * @return					The amount of triggers no laser can reach, or INDEX_NONE if the map could not be checked.
+	 */
+	int32 CheckMap(const FString& MapName) const;
+
+	// Gets the file the report of a map is written to.
+	static FString GetReportPath(const FString& MapName);
+};
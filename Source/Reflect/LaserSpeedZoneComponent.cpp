@@ -0,0 +1,18 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Reflect.h"
+#include "LaserSpeedZoneComponent.h"
+#include "LaserBase.h"
+
+
+ULaserSpeedZoneComponent::ULaserSpeedZoneComponent(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer)
+{
+	// Default values
+	TargetSpeed = 300.0f;
+	Acceleration = 600.0f;
+}
+
+void ULaserSpeedZoneComponent::ApplyToLaser(ALaserBase* Laser, float DeltaSeconds)
+{
+	Laser->SetSpeed(FMath::FInterpConstantTo(Laser->GetSpeed(), TargetSpeed, DeltaSeconds, Acceleration));
+}
@@ -0,0 +1,26 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "LaserAffectorComponent.h"
+#include "LaserSpeedZoneComponent.generated.h"
+
+/**
+ * Speeds lasers up or slows them down towards a target speed.
+ */
+UCLASS(ClassGroup = (Laser), meta = (BlueprintSpawnableComponent))
+class REFLECT_API ULaserSpeedZoneComponent : public ULaserAffectorComponent
+{
+	GENERATED_UCLASS_BODY()
+
+	// Affects a laser inside the volume.
+	virtual void ApplyToLaser(ALaserBase* Laser, float DeltaSeconds) override;
+
+	// The speed that lasers inside the volume move towards.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Laser")
+	float TargetSpeed;
+
+	// How fast the speed of lasers changes, in units per second squared.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Laser", meta = (ClampMin = "0"))
+	float Acceleration;
+};
@@ -0,0 +1,209 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Reflect.h"
+#include "LaserSteering.h"
+
+
+void FLaserSteering::TurnTowardsBatch(float* DirectionsX, float* DirectionsY, float* DirectionsZ, const float* GoalsX, const float* GoalsY, const float* GoalsZ, const float* CosMaxAngles, const float* SinMaxAngles, bool* OutReachedGoal, int32 Num)
+{
+	const VectorRegister SmallNumber = VectorSetFloat1(KINDA_SMALL_NUMBER);
+
+	int32 i = 0;
+	for (; i + 4 <= Num; i += 4)
+	{
+		const VectorRegister DirectionX = VectorLoad(DirectionsX + i);
+		const VectorRegister DirectionY = VectorLoad(DirectionsY + i);
+		const VectorRegister DirectionZ = VectorLoad(DirectionsZ + i);
+		const VectorRegister GoalX = VectorLoad(GoalsX + i);
+		const VectorRegister GoalY = VectorLoad(GoalsY + i);
+		const VectorRegister GoalZ = VectorLoad(GoalsZ + i);
+		const VectorRegister CosMaxAngle = VectorLoad(CosMaxAngles + i);
+		const VectorRegister SinMaxAngle = VectorLoad(SinMaxAngles + i);
+
+		const VectorRegister CosAngle = VectorMultiplyAdd(DirectionX, GoalX, VectorMultiplyAdd(DirectionY, GoalY, VectorMultiply(DirectionZ, GoalZ)));
+
+		// Both turn planes are computed, and the degenerate one is selected away
+		VectorRegister OrthogonalX = VectorSubtract(GoalX, VectorMultiply(CosAngle, DirectionX));
+		VectorRegister OrthogonalY = VectorSubtract(GoalY, VectorMultiply(CosAngle, DirectionY));
+		VectorRegister OrthogonalZ = VectorSubtract(GoalZ, VectorMultiply(CosAngle, DirectionZ));
+		const VectorRegister OrthogonalSizeSquared = VectorMultiplyAdd(OrthogonalX, OrthogonalX, VectorMultiplyAdd(OrthogonalY, OrthogonalY, VectorMultiply(OrthogonalZ, OrthogonalZ)));
+		const VectorRegister InvOrthogonalSize = VectorReciprocalSqrtAccurate(VectorMax(OrthogonalSizeSquared, SmallNumber));
+		OrthogonalX = VectorMultiply(OrthogonalX, InvOrthogonalSize);
+		OrthogonalY = VectorMultiply(OrthogonalY, InvOrthogonalSize);
+		OrthogonalZ = VectorMultiply(OrthogonalZ, InvOrthogonalSize);
+
+		const int32 BehindMask = VectorMaskBits(VectorCompareGT(SmallNumber, OrthogonalSizeSquared));
+		if (BehindMask)
+		{
+			// Rare, so the lanes with the goal straight behind are patched with the scalar fallback
+			float Orthogonal[3][4];
+			VectorStore(OrthogonalX, Orthogonal[0]);
+			VectorStore(OrthogonalY, Orthogonal[1]);
+			VectorStore(OrthogonalZ, Orthogonal[2]);
+			for (int32 Lane = 0; Lane < 4; Lane++)
+			{
+				if (BehindMask & (1 << Lane))
+				{
+					const FVector Direction(DirectionsX[i + Lane], DirectionsY[i + Lane], DirectionsZ[i + Lane]);
+					FVector Fallback = FVector::CrossProduct(FVector::UpVector, Direction).GetSafeNormal();
+					if (Fallback.IsZero())
+					{
+						Fallback = FVector::ForwardVector;
+					}
+					Orthogonal[0][Lane] = Fallback.X;
+					Orthogonal[1][Lane] = Fallback.Y;
+					Orthogonal[2][Lane] = Fallback.Z;
+				}
+			}
+			OrthogonalX = VectorLoad(Orthogonal[0]);
+			OrthogonalY = VectorLoad(Orthogonal[1]);
+			OrthogonalZ = VectorLoad(Orthogonal[2]);
+		}
+
+		VectorRegister TurnedX = VectorMultiplyAdd(CosMaxAngle, DirectionX, VectorMultiply(SinMaxAngle, OrthogonalX));
+		VectorRegister TurnedY = VectorMultiplyAdd(CosMaxAngle, DirectionY, VectorMultiply(SinMaxAngle, OrthogonalY));
+		VectorRegister TurnedZ = VectorMultiplyAdd(CosMaxAngle, DirectionZ, VectorMultiply(SinMaxAngle, OrthogonalZ));
+		const VectorRegister InvTurnedSize = VectorReciprocalSqrtAccurate(VectorMultiplyAdd(TurnedX, TurnedX, VectorMultiplyAdd(TurnedY, TurnedY, VectorMultiply(TurnedZ, TurnedZ))));
+		TurnedX = VectorMultiply(TurnedX, InvTurnedSize);
+		TurnedY = VectorMultiply(TurnedY, InvTurnedSize);
+		TurnedZ = VectorMultiply(TurnedZ, InvTurnedSize);
+
+		const VectorRegister ReachedGoal = VectorCompareGE(CosAngle, CosMaxAngle);
+		VectorStore(VectorSelect(ReachedGoal, GoalX, TurnedX), DirectionsX + i);
+		VectorStore(VectorSelect(ReachedGoal, GoalY, TurnedY), DirectionsY + i);
+		VectorStore(VectorSelect(ReachedGoal, GoalZ, TurnedZ), DirectionsZ + i);
+
+		const int32 ReachedMask = VectorMaskBits(ReachedGoal);
+		for (int32 Lane = 0; Lane < 4; Lane++)
+		{
+			OutReachedGoal[i + Lane] = (ReachedMask & (1 << Lane)) != 0;
+		}
+	}
+
+	// The directions that do not fill a register are turned one at a time
+	for (; i < Num; i++)
+	{
+		FVector Direction(DirectionsX[i], DirectionsY[i], DirectionsZ[i]);
+		OutReachedGoal[i] = TurnTowards(Direction, FVector(GoalsX[i], GoalsY[i], GoalsZ[i]), CosMaxAngles[i], SinMaxAngles[i]);
+		DirectionsX[i] = Direction.X;
+		DirectionsY[i] = Direction.Y;
+		DirectionsZ[i] = Direction.Z;
+	}
+}
+
+/***************************************/
+/* Benchmark                           */
+/***************************************/
+
+namespace
+{
+	// The steering math RotateVelocity used before FLaserSteering, kept to compare against.
+	FVector LegacyRotateVelocity(const FVector& Velocity, const FVector& NewDirection, float MaxAngle)
+	{
+		MaxAngle = FMath::Clamp(MaxAngle, 0.0f, 180.0f);
+
+		const FVector NormalizedVelocity = Velocity.GetSafeNormal();
+		const FVector NormalizedNewDirection = NewDirection.GetSafeNormal();
+		const float Angle = FMath::RadiansToDegrees(FMath::Acos(FVector::DotProduct(NormalizedVelocity, NormalizedNewDirection)));
+
+		if (Angle <= MaxAngle)
+		{
+			return NormalizedNewDirection * Velocity.Size();
+		}
+
+		FVector Orthogonal = FVector::CrossProduct(NormalizedVelocity, NormalizedNewDirection).GetSafeNormal();
+		if (Orthogonal.Equals(FVector::ZeroVector))
+		{
+			Orthogonal = FVector::UpVector;
+		}
+		return Velocity.RotateAngleAxis(FMath::Sign(Angle) * MaxAngle, Orthogonal);
+	}
+
+	void BenchmarkSteering(const TArray<FString>& Args)
+	{
+		const int32 NumLasers = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 1024;
+		const int32 NumSteps = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 144;
+
+		// Lasers turning 1 degree per step towards random goals, which most of them do not reach
+		FRandomStream Random(1337);
+		TArray<FVector> StartDirections;
+		TArray<FVector> Goals;
+		TArray<float> CosMaxAngles;
+		TArray<float> SinMaxAngles;
+		TArray<bool> ReachedGoal;
+		for (int32 i = 0; i < NumLasers; i++)
+		{
+			StartDirections.Add(Random.GetUnitVector());
+			Goals.Add(Random.GetUnitVector());
+		}
+		const float MaxAngle = 1.0f;
+		CosMaxAngles.Init(FMath::Cos(FMath::DegreesToRadians(MaxAngle)), NumLasers);
+		SinMaxAngles.Init(FMath::Sin(FMath::DegreesToRadians(MaxAngle)), NumLasers);
+		ReachedGoal.Init(false, NumLasers);
+
+		TArray<FVector> Velocities;
+		for (const FVector& Direction : StartDirections)
+		{
+			Velocities.Add(Direction * 600.0f);
+		}
+		double StartTime = FPlatformTime::Seconds();
+		for (int32 Step = 0; Step < NumSteps; Step++)
+		{
+			for (int32 i = 0; i < NumLasers; i++)
+			{
+				Velocities[i] = LegacyRotateVelocity(Velocities[i], Goals[i], MaxAngle);
+			}
+		}
+		const double LegacyTime = FPlatformTime::Seconds() - StartTime;
+
+		TArray<FVector> Directions = StartDirections;
+		StartTime = FPlatformTime::Seconds();
+		for (int32 Step = 0; Step < NumSteps; Step++)
+		{
+			for (int32 i = 0; i < NumLasers; i++)
+			{
+				FLaserSteering::TurnTowards(Directions[i], Goals[i], CosMaxAngles[i], SinMaxAngles[i]);
+			}
+		}
+		const double ScalarTime = FPlatformTime::Seconds() - StartTime;
+
+		// Compare against the legacy results, to make sure the kernels turn the same way
+		float MaxError = 0.0f;
+		for (int32 i = 0; i < NumLasers; i++)
+		{
+			MaxError = FMath::Max(MaxError, (Directions[i] - Velocities[i].GetSafeNormal()).Size());
+		}
+
+		TArray<float> DirectionsX, DirectionsY, DirectionsZ;
+		TArray<float> GoalsX, GoalsY, GoalsZ;
+		for (int32 i = 0; i < NumLasers; i++)
+		{
+			DirectionsX.Add(StartDirections[i].X);
+			DirectionsY.Add(StartDirections[i].Y);
+			DirectionsZ.Add(StartDirections[i].Z);
+			GoalsX.Add(Goals[i].X);
+			GoalsY.Add(Goals[i].Y);
+			GoalsZ.Add(Goals[i].Z);
+		}
+		StartTime = FPlatformTime::Seconds();
+		for (int32 Step = 0; Step < NumSteps; Step++)
+		{
+			FLaserSteering::TurnTowardsBatch(DirectionsX.GetData(), DirectionsY.GetData(), DirectionsZ.GetData(), GoalsX.GetData(), GoalsY.GetData(), GoalsZ.GetData(), CosMaxAngles.GetData(), SinMaxAngles.GetData(), ReachedGoal.GetData(), NumLasers);
+		}
+		const double BatchTime = FPlatformTime::Seconds() - StartTime;
+
+		// The batched kernel has to agree with the scalar one
+		for (int32 i = 0; i < NumLasers; i++)
+		{
+			MaxError = FMath::Max(MaxError, (FVector(DirectionsX[i], DirectionsY[i], DirectionsZ[i]) - Directions[i]).Size());
+		}
+
+		UE_LOG(LogReflect, Display, TEXT("Steering %d lasers for %d steps: legacy %.3f ms, scalar %.3f ms, batched %.3f ms, max difference %f"),
+			NumLasers, NumSteps, LegacyTime * 1000.0, ScalarTime * 1000.0, BatchTime * 1000.0, MaxError);
+	}
+
+	FAutoConsoleCommand BenchmarkSteeringCommand(
+		TEXT("Reflect.BenchmarkSteering"),
+		TEXT("Times the laser steering kernels against the old RotateVelocity math. Arguments: [NumLasers] [NumSteps]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkSteering));
+}
@@ -0,0 +1,67 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+/**
+ * Turns laser directions towards goal directions at a constant angular rate.
+ * Directions are turned along the great circle towards the goal, which is a slerp
+ * by a fixed angle, so only the sine and cosine of the step angle are needed.
+ */
+struct REFLECT_API FLaserSteering
+{
+	/**
+	 * Turns a direction towards a goal direction by at most an angle.
+	 * @param Direction			The unit direction to turn.
+	 * @param Goal				The unit direction to turn towards.
+	 * @param CosMaxAngle		Cosine of the maximum angle to turn.
+	 * @param SinMaxAngle		Sine of the maximum angle to turn.
+	 * @return					Whether the direction reached the goal.
+	 */
+	static FORCEINLINE bool TurnTowards(FVector& Direction, const FVector& Goal, float CosMaxAngle, float SinMaxAngle)
+	{
+		const float CosAngle = FVector::DotProduct(Direction, Goal);
+
+		// Snap to the goal if it is within the maximum angle
+		if (CosAngle >= CosMaxAngle)
+		{
+			Direction = Goal;
+			return true;
+		}
+
+		// The part of the goal that is orthogonal to the direction gives the plane to turn in
+		FVector Orthogonal = Goal - CosAngle * Direction;
+		const float OrthogonalSizeSquared = Orthogonal.SizeSquared();
+		if (OrthogonalSizeSquared < KINDA_SMALL_NUMBER)
+		{
+			// The goal is straight behind, so any plane works. Turn around the up axis like RotateVelocity used to.
+			Orthogonal = FVector::CrossProduct(FVector::UpVector, Direction).GetSafeNormal();
+			if (Orthogonal.IsZero())
+			{
+				Orthogonal = FVector::ForwardVector;
+			}
+		}
+		else
+		{
+			Orthogonal *= FMath::InvSqrt(OrthogonalSizeSquared);
+		}
+
+		Direction = (CosMaxAngle * Direction + SinMaxAngle * Orthogonal).GetUnsafeNormal();
+		return false;
+	}
+
+	/**
+	 * Turns many directions at once, four per vector register. Same as calling TurnTowards for each direction.
+	 * The components are passed as separate arrays, so each register holds one component of four directions.
+	 * @param DirectionsX		The X components of the unit directions to turn.
+	 * @param DirectionsY		The Y components of the unit directions to turn.
+	 * @param DirectionsZ		The Z components of the unit directions to turn.
+	 * @param GoalsX			The X components of the unit directions to turn towards.
+	 * @param GoalsY			The Y components of the unit directions to turn towards.
+	 * @param GoalsZ			The Z components of the unit directions to turn towards.
+	 * @param CosMaxAngles		Cosine of the maximum angle to turn, for each direction.
+	 * @param SinMaxAngles		Sine of the maximum angle to turn, for each direction.
+	 * @param OutReachedGoal	Whether each direction reached its goal.
+	 * @param Num				The amount of directions.
+	 */
+	static void TurnTowardsBatch(float* DirectionsX, float* DirectionsY, float* DirectionsZ, const float* GoalsX, const float* GoalsY, const float* GoalsZ, const float* CosMaxAngles, const float* SinMaxAngles, bool* OutReachedGoal, int32 Num);
+};
@@ -0,0 +1,17 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Reflect.h"
+#include "LaserSteeringZoneComponent.h"
+#include "LaserBase.h"
+
+
+ULaserSteeringZoneComponent::ULaserSteeringZoneComponent(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer)
+{
+	// Default values
+	TurnRate = 90.0f;
+}
+
+void ULaserSteeringZoneComponent::ApplyToLaser(ALaserBase* Laser, float DeltaSeconds)
+{
+	Laser->RotateVelocity(GetForwardVector(), TurnRate * DeltaSeconds);
+}
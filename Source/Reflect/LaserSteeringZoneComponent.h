@@ -0,0 +1,22 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "LaserAffectorComponent.h"
+#include "LaserSteeringZoneComponent.generated.h"
+
+/**
+ * Turns lasers towards the forward vector of the volume.
+ */
+UCLASS(ClassGroup = (Laser), meta = (BlueprintSpawnableComponent))
+class REFLECT_API ULaserSteeringZoneComponent : public ULaserAffectorComponent
+{
+	GENERATED_UCLASS_BODY()
+
+	// Affects a laser inside the volume.
+	virtual void ApplyToLaser(ALaserBase* Laser, float DeltaSeconds) override;
+
+	// How fast lasers turn towards the forward vector of the volume, in degrees per second.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Laser", meta = (ClampMin = "0"))
+	float TurnRate;
+};
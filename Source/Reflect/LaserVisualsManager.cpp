@@ -0,0 +1,230 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Reflect.h"
+#include "LaserVisualsManager.h"
+#include "LaserBase.h"
+#include "LaserSimulationManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Laser Trails"), STAT_LaserTrails, STATGROUP_Reflect);
+DECLARE_CYCLE_STAT(TEXT("Laser Light Budget"), STAT_LaserLightBudget, STATGROUP_Reflect);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Laser Trail Segments"), STAT_LaserTrailSegments, STATGROUP_Reflect);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Laser Lights"), STAT_LaserLights, STATGROUP_Reflect);
+
+
+ALaserVisualsManager::ALaserVisualsManager(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer)
+{
+	PrimaryActorTick.bCanEverTick = true;
+	// Lasers have been moved by the laser simulation by then
+	PrimaryActorTick.TickGroup = TG_PostPhysics;
+
+	// Default values
+	TrailMesh = nullptr;
+	TrailMaterial = nullptr;
+	TrailMeshLength = 100.0f;
+	TrailWidth = 0.05f;
+	bLimitLights = true;
+	MaxLights = 16;
+	LightFadeTime = 0.25f;
+
+	// Setup components
+	TrailInstances = ObjectInitializer.CreateDefaultSubobject<UInstancedStaticMeshComponent>(this, TEXT("TrailInstances"));
+	TrailInstances->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	TrailInstances->SetCastShadow(false);
+	TrailInstances->bGenerateOverlapEvents = false;
+	RootComponent = TrailInstances;
+}
+
+void ALaserVisualsManager::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (TrailMesh)
+	{
+		TrailInstances->SetStaticMesh(TrailMesh);
+		if (TrailMaterial)
+		{
+			TrailInstances->SetMaterial(0, TrailMaterial);
+		}
+	}
+}
+
+void ALaserVisualsManager::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	if (HasInstancedTrails())
+	{
+		UpdateTrails();
+	}
+
+	if (IsLimitingLights())
+	{
+		UpdateLights(DeltaSeconds);
+	}
+}
+
+void ALaserVisualsManager::UpdateTrails()
+{
+	SCOPE_CYCLE_COUNTER(STAT_LaserTrails);
+
+	ALaserSimulationManager* Simulation = ALaserSimulationManager::Get(this);
+	if (!Simulation)
+	{
+		return;
+	}
+
+	const TArray<ALaserBase*>& Lasers = Simulation->GetLasers();
+	const TArray<FVector>& Positions = Simulation->GetPositions();
+	const TArray<FLaserTrail>& Trails = Simulation->GetTrails();
+
+	int32 NumSegments = 0;
+	for (int32 i = 0; i < Lasers.Num(); i++)
+	{
+		// Nobody can see the trails of hidden lasers
+		if (!Lasers[i] || Lasers[i]->GetSignificance() == ELaserSignificance::Hidden)
+		{
+			continue;
+		}
+
+		// From the laser, through its recorded positions from newest to oldest
+		const FLaserTrail& Trail = Trails[i];
+		FVector Start = Positions[i];
+		for (int32 Age = 0; Age < Trail.Num; Age++)
+		{
+			const FVector& End = Trail.GetPoint(Age);
+			const float Width = TrailWidth * (1.0f - (float)Age / FLaserTrail::MaxPoints);
+			SetTrailSegment(NumSegments++, Start, End, Width);
+			Start = End;
+		}
+	}
+
+	// Segments of lasers that died are removed from the end, so no other segment has to move
+	const int32 NumInstances = TrailInstances->GetInstanceCount();
+	for (int32 Index = NumInstances - 1; Index >= NumSegments; Index--)
+	{
+		TrailInstances->RemoveInstance(Index);
+	}
+
+	TrailInstances->MarkRenderStateDirty();
+	SET_DWORD_STAT(STAT_LaserTrailSegments, NumSegments);
+}
+
+void ALaserVisualsManager::SetTrailSegment(int32 Index, const FVector& Start, const FVector& End, float Width)
+{
+	const FVector Segment = End - Start;
+	const FTransform Transform(Segment.Rotation(), (Start + End) * 0.5f, FVector(Segment.Size() / TrailMeshLength, Width, Width));
+
+	if (Index < TrailInstances->GetInstanceCount())
+	{
+		TrailInstances->UpdateInstanceTransform(Index, Transform, true, false, true);
+	}
+	else
+	{
+		TrailInstances->AddInstanceWorldSpace(Transform);
+	}
+}
+
+void ALaserVisualsManager::UpdateLights(float DeltaSeconds)
+{
+	SCOPE_CYCLE_COUNTER(STAT_LaserLightBudget);
+
+	ALaserSimulationManager* Simulation = ALaserSimulationManager::Get(this);
+	APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+	if (!Simulation || !PlayerController || !PlayerController->PlayerCameraManager)
+	{
+		return;
+	}
+
+	const APlayerCameraManager* Camera = PlayerController->PlayerCameraManager;
+	const FVector CameraLocation = Camera->GetCameraLocation();
+	const FVector CameraForward = Camera->GetCameraRotation().Vector();
+	const float HalfFOV = FMath::DegreesToRadians(Camera->GetFOVAngle() * 0.5f);
+	const float InvTanHalfFOV = 1.0f / FMath::Tan(HalfFOV);
+
+	const TArray<ALaserBase*>& Lasers = Simulation->GetLasers();
+	const TArray<FVector>& Positions = Simulation->GetPositions();
+
+	// Lights are ranked by how much of the screen they could light, weighted by their brightness
+	LightCandidates.Reset();
+	for (int32 i = 0; i < Lasers.Num(); i++)
+	{
+		ALaserBase* Laser = Lasers[i];
+		if (!Laser)
+		{
+			continue;
+		}
+
+		const float Radius = Laser->LightComp->AttenuationRadius;
+		const FVector ToLight = Positions[i] - CameraLocation;
+		const float Distance = ToLight.Size();
+
+		float Importance;
+		if (Distance <= Radius)
+		{
+			// The camera is inside the light, so it covers the whole screen
+			Importance = Laser->LightIntensity;
+		}
+		else
+		{
+			// Lights whose sphere of influence is outside the view cone cannot light anything on screen
+			const float AngleToLight = FMath::Acos(FMath::Clamp(FVector::DotProduct(ToLight / Distance, CameraForward), -1.0f, 1.0f));
+			const float AngularRadius = FMath::Asin(Radius / Distance);
+			const bool bOnScreen = AngleToLight - AngularRadius < HalfFOV;
+
+			const float ScreenRadius = FMath::Min(Radius / Distance * InvTanHalfFOV, 1.0f);
+			Importance = bOnScreen ? Laser->LightIntensity * FMath::Square(ScreenRadius) : 0.0f;
+		}
+
+		// Lights are one of the effects insignificant lasers go without
+		if (Laser->GetSignificance() != ELaserSignificance::Full)
+		{
+			Importance = 0.0f;
+		}
+
+		LightCandidates.Emplace(Importance, Laser);
+	}
+
+	if (LightCandidates.Num() > MaxLights)
+	{
+		LightCandidates.Sort([](const TPair<float, ALaserBase*>& A, const TPair<float, ALaserBase*>& B)
+		{
+			return A.Key > B.Key;
+		});
+	}
+
+	// Lasers without a light fall back to their emissive look, through ALaserBase::LightFadeParameter
+	const float FadeSpeed = LightFadeTime > 0.0f ? 1.0f / LightFadeTime : BIG_NUMBER;
+	int32 NumLights = 0;
+	for (int32 Index = 0; Index < LightCandidates.Num(); Index++)
+	{
+		ALaserBase* Laser = LightCandidates[Index].Value;
+		const float TargetFade = Index < MaxLights && LightCandidates[Index].Key > 0.0f ? 1.0f : 0.0f;
+		if (Laser->LightFade != TargetFade)
+		{
+			Laser->SetLightFade(FMath::FInterpConstantTo(Laser->LightFade, TargetFade, DeltaSeconds, FadeSpeed));
+		}
+
+		if (Laser->LightFade > 0.0f)
+		{
+			NumLights++;
+		}
+	}
+
+	SET_DWORD_STAT(STAT_LaserLights, NumLights);
+}
+
+bool ALaserVisualsManager::HasInstancedTrails() const
+{
+	return TrailMesh != nullptr;
+}
+
+bool ALaserVisualsManager::IsLimitingLights() const
+{
+	return bLimitLights;
+}
+
+ALaserVisualsManager* ALaserVisualsManager::Get(UObject* WorldContextObject)
+{
+	static TWeakObjectPtr<ALaserVisualsManager> CachedManager;
+	return GetOrSpawnWorldActor(WorldContextObject, CachedManager);
+}
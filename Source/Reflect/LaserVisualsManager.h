@@ -0,0 +1,90 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "GameFramework/Actor.h"
+#include "LaserVisualsManager.generated.h"
+
+class ALaserBase;
+
+/**
+ * Draws the visuals of every live laser in the world together.
+ * Trails are drawn as instanced mesh segments between the positions recorded by the laser simulation,
+ * instead of a particle system per laser, and only the most important lasers get a point light.
+ * Place one in a map to configure it. Without a trail mesh, lasers keep using their trail particles.
+ */
+UCLASS()
+class REFLECT_API ALaserVisualsManager : public AActor
+{
+	GENERATED_UCLASS_BODY()
+
+	// Called when the object is spawned.
+	virtual void BeginPlay() override;
+
+	// Called every frame.
+	virtual void Tick(float DeltaSeconds) override;
+
+	// Instanced mesh that draws the trail segments of every laser.
+	UPROPERTY(VisibleDefaultsOnly, Category = "Laser Visuals")
+	UInstancedStaticMeshComponent* TrailInstances;
+
+	// The mesh of a trail segment. It should be centered on its pivot and point along X.
+	UPROPERTY(EditAnywhere, Category = "Laser Visuals|Trails")
+	UStaticMesh* TrailMesh;
+
+	// Overrides the material of the trail mesh.
+	UPROPERTY(EditAnywhere, Category = "Laser Visuals|Trails")
+	UMaterialInterface* TrailMaterial;
+
+	// The length of the trail mesh along X.
+	UPROPERTY(EditAnywhere, Category = "Laser Visuals|Trails", meta = (ClampMin = "0.01"))
+	float TrailMeshLength;
+
+	// The scale of the trail mesh across the trail, at the laser. It tapers off towards the end of the trail.
+	UPROPERTY(EditAnywhere, Category = "Laser Visuals|Trails", meta = (ClampMin = "0.0"))
+	float TrailWidth;
+
+	// Whether the amount of laser point lights is limited.
+	UPROPERTY(EditAnywhere, Category = "Laser Visuals|Lights")
+	bool bLimitLights;
+
+	// The maximum amount of lasers with a point light. Lights that are fading out can briefly exceed it.
+	UPROPERTY(EditAnywhere, Category = "Laser Visuals|Lights", meta = (ClampMin = "0", EditCondition = "bLimitLights"))
+	int32 MaxLights;
+
+	// The time it takes a light to fade in or out when it gains or loses its place in the budget.
+	UPROPERTY(EditAnywhere, Category = "Laser Visuals|Lights", meta = (ClampMin = "0.0", EditCondition = "bLimitLights"))
+	float LightFadeTime;
+
+	// Whether trails are drawn by this manager instead of the trail particles of each laser.
+	bool HasInstancedTrails() const;
+
+	// Whether lasers should wait for this manager to turn on their light.
+	bool IsLimitingLights() const;
+
+	// Gets the laser visuals of the world, spawning one if it does not exist.
+	static ALaserVisualsManager* Get(UObject* WorldContextObject);
+
+private:
+
+	// Moves the trail segments to the recorded positions of the lasers.
+	void UpdateTrails();
+
+	/**
+	 * Fades in the lights of the most important lasers, and fades out the others.
+	 * @param DeltaSeconds		The duration of the frame.
+	 */
+	void UpdateLights(float DeltaSeconds);
+
+	/**
+	 * Sets the transform of a trail segment, adding it if there are not enough.
+	 * @param Index				The index of the segment.
+	 * @param Start				The start of the segment.
+	 * @param End				The end of the segment.
+	 * @param Width				The scale across the segment.
+	 */
+	void SetTrailSegment(int32 Index, const FVector& Start, const FVector& End, float Width);
+
+	// The lasers that could have a light, and how important their light is.
+	TArray<TPair<float, ALaserBase*>> LightCandidates;
+};
@@ -3,3 +3,5 @@
 #include "Reflect.h"
 
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, Reflect, "Reflect" );
+
+DEFINE_LOG_CATEGORY(LogReflect);
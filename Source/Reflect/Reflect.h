@@ -4,3 +4,67 @@
 
 #include "Engine.h"
 
+DECLARE_LOG_CATEGORY_EXTERN(LogReflect, Log, All);
+
+// Stats of the laser gameplay, shown with "stat Reflect".
+DECLARE_STATS_GROUP(TEXT("Reflect"), STATGROUP_Reflect, STATCAT_Advanced);
+
+// Collision channel of lasers, set up in DefaultEngine.ini.
+#define ECC_Laser ECC_GameTraceChannel1
+
+/**
+ * Gets the first actor of a class in the world of a context object, without spawning one.
+ * Safe to call where spawning is not, like physics callbacks and teardown.
+ * @param WorldContextObject	Object used to find the world.
+ * @param CachedActor			The actor found by the last call, which is checked before searching the world.
+ */
+template<typename ActorType>
+ActorType* FindWorldActor(UObject* WorldContextObject, TWeakObjectPtr<ActorType>& CachedActor)
+{
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject);
+	if (!World)
+	{
+		return nullptr;
+	}
+
+	// Most lookups come from the same world, so the last found actor is usually the right one
+	if (CachedActor.IsValid() && CachedActor->GetWorld() == World)
+	{
+		return CachedActor.Get();
+	}
+
+	for (TActorIterator<ActorType> It(World); It; ++It)
+	{
+		if (!It->IsPendingKill())
+		{
+			CachedActor = *It;
+			return *It;
+		}
+	}
+	return nullptr;
+}
+
+/**
+ * Gets the first actor of a class in the world of a context object, and spawns one if the world has none.
+ * @param WorldContextObject	Object used to find the world.
+ * @param CachedActor			The actor found by the last call, which is checked before searching the world.
+ */
+template<typename ActorType>
+ActorType* GetOrSpawnWorldActor(UObject* WorldContextObject, TWeakObjectPtr<ActorType>& CachedActor)
+{
+	if (ActorType* Actor = FindWorldActor(WorldContextObject, CachedActor))
+	{
+		return Actor;
+	}
+
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject);
+	if (!World)
+	{
+		return nullptr;
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	CachedActor = World->SpawnActor<ActorType>(SpawnParams);
+	return CachedActor.Get();
+}